@@ -0,0 +1,53 @@
+#include "arena.h"
+#include <new>
+
+using subman::arena;
+
+namespace {
+
+  // the header keeps the blocks aligned as much as the heap does
+  constexpr size_t header_size = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+} // namespace
+
+void* arena::do_allocate(size_t bytes, size_t alignment) {
+  if (bytes <= big_size || alignment > header_size)
+    return chunks.allocate(bytes, alignment);
+
+  auto* const b = static_cast<block*>(::operator new(header_size + bytes));
+  b->previous = nullptr;
+  b->next = blocks;
+  if (blocks)
+    blocks->previous = b;
+  blocks = b;
+  return reinterpret_cast<char*>(b) + header_size;
+}
+
+void arena::do_deallocate(void* p, size_t bytes, size_t alignment) {
+  // the small ones go when the whole arena goes
+  if (bytes <= big_size || alignment > header_size)
+    return;
+
+  auto* const b =
+      reinterpret_cast<block*>(static_cast<char*>(p) - header_size);
+  if (b->previous)
+    b->previous->next = b->next;
+  else
+    blocks = b->next;
+  if (b->next)
+    b->next->previous = b->previous;
+  ::operator delete(b);
+}
+
+void arena::release() noexcept {
+  chunks.release();
+  while (blocks) {
+    auto* const next = blocks->next;
+    ::operator delete(blocks);
+    blocks = next;
+  }
+}
+
+arena::~arena() noexcept {
+  release();
+}
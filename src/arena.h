@@ -0,0 +1,51 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <memory_resource>
+
+namespace subman {
+
+  /**
+   * @brief The memory of a document: the text and the attributes of its
+   * subtitles are cut out of big chunks and are never freed one by one
+   * The big blocks (the list of the subtitles itself) come from the heap and
+   * go back to it when they're given back, so growing the list doesn't leave
+   * its old copies behind. "release" frees everything at once, in
+   * O(chunks); whatever was in there is just forgotten.
+   */
+  class arena final : public std::pmr::memory_resource {
+    // the header of a big block, right before it
+    struct block {
+      block* previous;
+      block* next;
+    };
+
+    std::pmr::monotonic_buffer_resource chunks{initial_size};
+    block* blocks = nullptr;
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(
+        std::pmr::memory_resource const& other) const noexcept override {
+      return this == &other;
+    }
+
+  public:
+    // the first chunk; the next ones grow from this
+    static constexpr size_t initial_size = 16 * 1024;
+
+    // the blocks that are bigger than this go to the heap
+    static constexpr size_t big_size = 16 * 1024;
+
+    arena() = default;
+    arena(arena const&) = delete;
+    arena& operator=(arena const&) = delete;
+    ~arena() noexcept override;
+
+    void release() noexcept;
+  };
+
+} // namespace subman
+
+#endif // ARENA_H
@@ -0,0 +1,231 @@
+#include "cache.h"
+#include "formats/microdvd.h"
+#include "mapped_file.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string_view>
+#include <sys/stat.h>
+
+namespace {
+
+  constexpr char cache_magic[8] = {'S', 'U', 'B', 'M', 'A', 'N', 'C', '1'};
+  constexpr uint32_t cache_version = 2;
+
+  using subman::cache_stamp;
+
+  struct cache_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    cache_stamp stamp;
+    uint64_t cue_count;
+    uint64_t attr_count;
+    uint64_t text_size;
+  };
+
+  struct cache_cue {
+    uint64_t from, to;
+    uint64_t text;  // where the content starts in the text
+    uint64_t attrs; // the index of the first attribute
+  };
+
+  struct cache_attr {
+    uint64_t name, value; // where they start in the text
+    uint32_t start, finish;
+    uint32_t name_size, value_size;
+  };
+
+  static_assert(sizeof(cache_header) % 8 == 0);
+  static_assert(sizeof(cache_cue) % 8 == 0);
+  static_assert(sizeof(cache_attr) % 8 == 0);
+
+  template <typename T>
+  void append_raw(std::string& out, T const& value) {
+    out.append(reinterpret_cast<char const*>(&value), sizeof(T));
+  }
+
+  template <typename T>
+  T read_raw(std::string_view data, size_t offset) noexcept {
+    T value;
+    std::memcpy(&value, data.data() + offset, sizeof(T));
+    return value;
+  }
+
+} // namespace
+
+std::string subman::cache_path(std::string const& source) {
+  return source + ".smc";
+}
+
+std::optional<cache_stamp> subman::stamp_of(std::string const& source,
+                                            bool frame_based) noexcept {
+  struct stat info {};
+  if (::stat(source.c_str(), &info) == -1)
+    return std::nullopt;
+  cache_stamp stamp{
+      static_cast<uint64_t>(info.st_size),
+      static_cast<int64_t>(info.st_mtim.tv_sec) * 1'000'000'000 +
+          info.st_mtim.tv_nsec};
+  if (frame_based) {
+    auto const fps = subman::formats::microdvd::frame_rate;
+    stamp.fps_num = fps.num;
+    stamp.fps_den = fps.den;
+  }
+  return stamp;
+}
+
+bool subman::write_cache(subman::document const& doc,
+                         std::string const& source,
+                         cache_stamp const& stamp) {
+  // it'd hold the old content under the new stamp
+  if (stamp_of(source, stamp.fps_den != 0) != stamp)
+    return false;
+
+  std::string cues, attrs, text;
+  std::map<std::string_view, uint64_t> names; // the distinct names and values
+  std::string extras;
+  auto const intern = [&](std::string_view str) {
+    auto [it, fresh] = names.try_emplace(str, extras.size());
+    if (fresh)
+      extras += str;
+    return it->second;
+  };
+
+  uint64_t attr_count = 0;
+  for (auto const& sub : doc.subtitles) {
+    append_raw(cues,
+               cache_cue{sub.timestamps.from,
+                         sub.timestamps.to,
+                         text.size(),
+                         attr_count});
+    text += sub.content.cget_content();
+    for (auto const& a : sub.content.cget_attrs()) {
+      std::string_view const value = a.value;
+      append_raw(attrs,
+                 cache_attr{intern(a.name()),
+                            intern(value),
+                            static_cast<uint32_t>(a.pos.start),
+                            static_cast<uint32_t>(a.pos.finish),
+                            static_cast<uint32_t>(a.name().size()),
+                            static_cast<uint32_t>(value.size())});
+      ++attr_count;
+    }
+  }
+  append_raw(cues, cache_cue{0, 0, text.size(), attr_count});
+
+  // the names and values go after the contents
+  auto const contents = text.size();
+  for (size_t i = 0; i < attrs.size(); i += sizeof(cache_attr)) {
+    auto a = read_raw<cache_attr>(attrs, i);
+    a.name += contents;
+    a.value += contents;
+    std::memcpy(attrs.data() + i, &a, sizeof(a));
+  }
+  text += extras;
+
+  cache_header header{};
+  std::memcpy(header.magic, cache_magic, sizeof(cache_magic));
+  header.version = cache_version;
+  header.header_size = sizeof(cache_header);
+  header.stamp = stamp;
+  header.cue_count = doc.subtitles.size();
+  header.attr_count = attr_count;
+  header.text_size = text.size();
+
+  // written aside and then renamed, so the readers see all of it or nothing
+  auto const path = cache_path(source);
+  auto const temporary = path + ".tmp";
+  {
+    std::ofstream out(temporary, std::ios::out | std::ios::binary);
+    if (!out.good())
+      throw std::invalid_argument("Error: Cannot open file '" + temporary +
+                                  "'");
+    out.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    out << cues << attrs << text;
+    if (!out.flush())
+      throw std::invalid_argument("Error: Cannot write '" + temporary + "'.");
+  }
+  if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+    std::remove(temporary.c_str());
+    throw std::invalid_argument("Error: Cannot write '" + path + "'.");
+  }
+  return true;
+}
+
+std::optional<subman::document>
+subman::load_cache(std::string const& source) {
+  auto const path = cache_path(source);
+  struct stat info {};
+  if (::stat(path.c_str(), &info) == -1)
+    return std::nullopt;
+
+  subman::mapped_file file{path};
+  auto const data = file.view();
+  if (data.size() < sizeof(cache_header))
+    return std::nullopt;
+  auto const header = read_raw<cache_header>(data, 0);
+  if (std::memcmp(header.magic, cache_magic, sizeof(cache_magic)) != 0 ||
+      header.version != cache_version ||
+      header.header_size != sizeof(cache_header))
+    return std::nullopt;
+  // the stamp tells whether the source was frame-based
+  auto const stamp = stamp_of(source, header.stamp.fps_den != 0);
+  if (!stamp || header.stamp != *stamp)
+    return std::nullopt;
+
+  // the sizes are checked before anything is read, a stale or broken cache
+  // is just ignored
+  auto const cues_offset = sizeof(cache_header);
+  auto const attrs_offset =
+      cues_offset + (header.cue_count + 1) * sizeof(cache_cue);
+  auto const text_offset =
+      attrs_offset + header.attr_count * sizeof(cache_attr);
+  if (header.cue_count >= data.size() / sizeof(cache_cue) ||
+      header.attr_count >= data.size() / sizeof(cache_attr) ||
+      text_offset > data.size() ||
+      header.text_size != data.size() - text_offset)
+    return std::nullopt;
+  auto const text = data.substr(text_offset);
+  auto const cue_at = [&](uint64_t i) {
+    return read_raw<cache_cue>(data, cues_offset + i * sizeof(cache_cue));
+  };
+
+  subman::document doc;
+  auto const alloc = doc.subtitles.get_allocator();
+  auto cue = cue_at(0);
+  for (uint64_t i = 0; i < header.cue_count; ++i) {
+    auto const next = cue_at(i + 1);
+    if (next.text < cue.text || next.text > text.size() ||
+        next.attrs < cue.attrs || next.attrs > header.attr_count)
+      return std::nullopt;
+
+    subman::attr_list attrs{alloc};
+    for (auto j = cue.attrs; j < next.attrs; ++j) {
+      auto const a = read_raw<cache_attr>(
+          data, attrs_offset + j * sizeof(cache_attr));
+      if (a.name > text.size() || a.name_size > text.size() - a.name ||
+          a.value > text.size() || a.value_size > text.size() - a.value)
+        return std::nullopt;
+      auto const kind = subman::attr_kind_of(text.substr(a.name, a.name_size));
+      if (!kind)
+        return std::nullopt;
+      attrs.emplace_back(subman::range{a.start, a.finish},
+                         *kind,
+                         text.substr(a.value, a.value_size));
+    }
+    // they were written in the document's order
+    doc.subtitles.emplace_hint(
+        doc.subtitles.end(),
+        subman::styledstring{
+            std::pmr::string{text.substr(cue.text, next.text - cue.text),
+                             alloc},
+            std::move(attrs)},
+        subman::duration{cue.from, cue.to});
+    cue = next;
+  }
+  return doc;
+}
@@ -0,0 +1,69 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "document.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+
+/**
+ * A binary copy of a loaded document that sits next to its subtitle file
+ * ("a.srt.smc") and is mapped back without any parsing. It's only used when
+ * it was written for the file as it is now (the same size and modification
+ * time) and with the same reading settings (the default frame rate, for the
+ * MicroDVD files only).
+ *
+ * The layout is native-endian and every table starts at a multiple of 8:
+ *
+ *   header   "SUBMANC1", version, the source's stamp, the counts
+ *   cues     [count + 1] start, end, text offset, first attribute
+ *   attrs    [attr count] name offset, value offset, range, name and
+ *            value sizes
+ *   text     the contents, then the distinct names and values
+ *
+ * The last cue only has the offsets, so a cue's text and attributes end
+ * where the next cue's start.
+ */
+namespace subman {
+
+  /**
+   * @brief where the cache of a subtitle file goes
+   */
+  std::string cache_path(std::string const& source);
+
+  /**
+   * @brief what a cached document was read from, and how
+   */
+  struct cache_stamp {
+    uint64_t source_size = 0;
+    int64_t source_mtime = 0;         // in nanoseconds
+    uint64_t fps_num = 0, fps_den = 0; // zero when it's not frame-based
+
+    bool operator==(cache_stamp const&) const = default;
+  };
+
+  /**
+   * @brief the stamp of the source as it is now; the frame rate only counts
+   * for the frame-based formats
+   */
+  std::optional<cache_stamp> stamp_of(std::string const& source,
+                                      bool frame_based) noexcept;
+
+  /**
+   * @brief writes the document that was loaded from the source into its cache
+   * @param stamp the stamp of the source from before it was loaded
+   * @return false if the source has been changed since then, in which case
+   * nothing is written
+   */
+  bool write_cache(subman::document const& doc,
+                   std::string const& source,
+                   cache_stamp const& stamp);
+
+  /**
+   * @brief loads the cache of the source, if there's a fresh one
+   */
+  std::optional<subman::document> load_cache(std::string const& source);
+
+} // namespace subman
+
+#endif // CACHE_H
@@ -1,8 +1,13 @@
 #include "document.h"
+#include <algorithm>
 #include <boost/lexical_cast.hpp>
 #include <exception>
+#include <iterator>
+#include <memory_resource>
 #include <regex>
+#include <string_view>
 #include <tuple>
+#include <utility>
 
 using namespace subman;
 
@@ -69,163 +74,171 @@ styledstring merge_styledstring(styledstring const& first,
   return merged;
 }
 
-void document::put_subtitle(subtitle&& v, merge_method const& mm) noexcept {
-  auto lower_bound = subtitles.lower_bound(v);
-  auto end = std::end(subtitles);
-  auto begin = std::begin(subtitles);
-  auto collided_subtitle = end;
-
-  if (lower_bound != end &&
-      lower_bound->timestamps.has_collide_with(v.timestamps))
-    collided_subtitle = lower_bound;
-
-  if (lower_bound != begin) {
-    auto before_lower_bound = std::prev(lower_bound);
-    if (before_lower_bound->timestamps.has_collide_with(v.timestamps))
-      collided_subtitle = before_lower_bound;
-  }
-
-  if (collided_subtitle != begin &&
-      std::prev(collided_subtitle)->timestamps.has_collide_with(v.timestamps))
-    collided_subtitle--;
-
-  // there is no collision between subtitles
-  if (collided_subtitle == end) {
-    // just insert the damn thing
-    subtitles.emplace_hint(lower_bound, std::move(v));
-    return;
-  }
-
-  // duplicated subtitles are ignored
-  if (*collided_subtitle == v) {
-    return;
-  }
-
-  // both subtitles are in the same time but with different content;
-  // so we change the content just for that subtitle
-  if (collided_subtitle->timestamps == v.timestamps) {
-    collided_subtitle->content =
-        merge_styledstring(collided_subtitle->content, v.content, mm);
-    return;
-  }
-
-  auto next_sub = std::next(collided_subtitle);
-
-  // when one of the subtitles are between the other one. doen't matter which
-  auto ainb = v.timestamps.in_between(collided_subtitle->timestamps);
-  auto bina = collided_subtitle->timestamps.in_between(v.timestamps);
-  if (ainb || bina) {
-    auto outter = bina ? v : *collided_subtitle;
-    auto inner = bina ? *collided_subtitle : v;
-
-    // we just don't care if the new subtitle is the same as the other one that
-    // already exists and it's timestamps is just almost the same.
-    if (ainb && inner.content.cget_content() == outter.content.cget_content())
-      return;
-
-    auto merged = merge_styledstring(collided_subtitle->content, v.content, mm);
-
-    // removing collided_subtitle
-    subtitles.erase(collided_subtitle);
-
-    // first part
-    if (outter.timestamps.from != inner.timestamps.from) {
-      subtitles.emplace_hint(
-          next_sub,
-          outter.content,
-          duration{outter.timestamps.from, inner.timestamps.from});
+namespace {
+
+  /**
+   * @brief splits the subtitle that's already there and the one that collides
+   * with it, into the parts that replace it
+   * @return false if the one that's already there stays as it is
+   */
+  bool split_collision(subtitle const& existing,
+                       subtitle const& v,
+                       merge_method const& mm,
+                       std::pmr::vector<subtitle>& parts) {
+    // they don't collide at all (one of them is broken); they're both kept
+    if (!existing.timestamps.has_collide_with(v.timestamps)) {
+      if (v < existing)
+        parts.push_back(v);
+      parts.push_back(existing);
+      if (existing < v)
+        parts.push_back(v);
+      return true;
     }
 
-    // the middle part
-    subtitles.emplace_hint(next_sub, std::move(merged), inner.timestamps);
+    // duplicated subtitles are ignored
+    if (existing == v) {
+      return false;
+    }
 
-    // the last part
-    if (outter.timestamps.to != inner.timestamps.to) {
-      subtitles.emplace_hint(
-          next_sub,
-          outter.content,
-          duration{inner.timestamps.to, outter.timestamps.to});
+    // both subtitles are in the same time but with different content;
+    // so we change the content just for that subtitle
+    if (existing.timestamps == v.timestamps) {
+      parts.emplace_back(merge_styledstring(existing.content, v.content, mm),
+                         existing.timestamps);
+      return true;
     }
 
-    return;
-  }
+    // when one of the subtitles are between the other one. doen't matter
+    // which
+    auto ainb = v.timestamps.in_between(existing.timestamps);
+    auto bina = existing.timestamps.in_between(v.timestamps);
+    if (ainb || bina) {
+      auto const& outter = bina ? v : existing;
+      auto const& inner = bina ? existing : v;
+
+      // we just don't care if the new subtitle is the same as the other one
+      // that already exists and it's timestamps is just almost the same.
+      if (ainb &&
+          inner.content.cget_content() == outter.content.cget_content())
+        return false;
+
+      // first part
+      if (outter.timestamps.from != inner.timestamps.from) {
+        parts.emplace_back(
+            outter.content,
+            duration{outter.timestamps.from, inner.timestamps.from});
+      }
 
-  // when one subtitle has collision with the other one.
-  // this part of the code is for when there's only one collison happening.
-  if (next_sub == end || !v.timestamps.has_collide_with(next_sub->timestamps)) {
-    auto first =
-        v.timestamps <= collided_subtitle->timestamps ? v : *collided_subtitle;
-    auto second =
-        v.timestamps > collided_subtitle->timestamps ? v : *collided_subtitle;
+      // the middle part
+      parts.emplace_back(merge_styledstring(existing.content, v.content, mm),
+                         inner.timestamps);
 
-    auto merged = merge_styledstring(collided_subtitle->content, v.content, mm);
+      // the last part
+      if (outter.timestamps.to != inner.timestamps.to) {
+        parts.emplace_back(
+            outter.content,
+            duration{inner.timestamps.to, outter.timestamps.to});
+      }
+      return true;
+    }
 
-    // removing collided_subtitle
-    subtitles.erase(collided_subtitle);
+    // when one subtitle has collision with the other one.
+    auto const& first = v.timestamps <= existing.timestamps ? v : existing;
+    auto const& second = v.timestamps > existing.timestamps ? v : existing;
 
     // first part
     if (first.timestamps.from != second.timestamps.from) {
-      // put_subtitle({
-      //   first.content,
-      //   duration{first.timestamps.from, second.timestamps.from}}, mm);
-      subtitles.emplace_hint(
-          next_sub,
+      parts.emplace_back(
           first.content,
           duration{first.timestamps.from, second.timestamps.from});
     }
 
     // middle part
-    subtitles.emplace_hint(
-        next_sub,
-        std::move(merged),
-        duration{second.timestamps.from, first.timestamps.to});
+    parts.emplace_back(merge_styledstring(existing.content, v.content, mm),
+                       duration{second.timestamps.from, first.timestamps.to});
 
     // the last part
     // we actually don't need this if statement. it's always true
     if (first.timestamps.to != second.timestamps.to) {
-      subtitles.emplace_hint(
-          next_sub,
-          second.content,
-          duration{first.timestamps.to, second.timestamps.to});
+      parts.emplace_back(second.content,
+                         duration{first.timestamps.to, second.timestamps.to});
     }
+    return true;
+  }
 
+} // namespace
+
+void document::put_subtitle(subtitle&& v, merge_method const& mm) noexcept {
+  auto const collided = subtitles.overlapping(v.timestamps);
+
+  // there is no collision between subtitles
+  if (collided.empty()) {
+    // just insert the damn thing
+    subtitles.insert(std::move(v));
     return;
   }
 
-  // the rest of the times:
-  // it means that we have collision with at least 2 other subtitles
-  if (v.timestamps < collided_subtitle->timestamps) {
-    // inserting the first part
-    subtitles.emplace_hint(
-        collided_subtitle,
-        v.content,
-        duration{v.timestamps.from, collided_subtitle->timestamps.from});
-  }
-  auto it = collided_subtitle;
-  std::vector<subtitle> subtitle_registery;
-  for (; it != end && v.timestamps.has_collide_with(it->timestamps); ++it) {
-    // this put_subtitle will remove the collided subtitle anyway
-    // so we don't need to do that, but we have to be careful about the
-    // iterator in the for loop. so we did this:
-    auto next = std::next(it);
-    auto from = std::max(v.timestamps.from, it->timestamps.from);
-    auto to = next == end ? std::min(v.timestamps.to, it->timestamps.to)
-                          : std::min(v.timestamps.to, next->timestamps.from);
-
-    // we are not going to merge the settings here. that was a miskate I made
-    subtitle_registery.emplace_back(v.content, duration{from, to});
+  // the collided subtitles are replaced with the parts, all at once
+  auto const& existing = std::as_const(subtitles);
+  std::pmr::vector<subtitle> parts{subtitles.get_allocator()};
+  if (collided.size() == 1) {
+    if (!split_collision(existing[collided.front()], v, mm, parts))
+      return;
+  } else {
+    // it collides with at least 2 other subtitles: the part before the first
+    // one, and then a part for each of them that goes on until the next one
+    // starts; each of them only collides with that one
+    auto const& first = existing[collided.front()];
+    if (v.timestamps.from < first.timestamps.from) {
+      parts.emplace_back(
+          v.content, duration{v.timestamps.from, first.timestamps.from});
+    }
+    for (size_t i = 0; i < collided.size(); ++i) {
+      auto const& sub = existing[collided[i]];
+      auto const from = std::max(v.timestamps.from, sub.timestamps.from);
+      auto const to =
+          i + 1 == collided.size()
+              ? v.timestamps.to
+              : std::min(v.timestamps.to,
+                         existing[collided[i + 1]].timestamps.from);
+
+      // we are not going to merge the settings here. that was a miskate I
+      // made
+      if (!split_collision(sub, subtitle{v.content, duration{from, to}},
+                           mm, parts))
+        parts.push_back(sub);
+    }
   }
 
-  for (auto& sub : subtitle_registery) {
-    put_subtitle(std::move(sub), mm);
+  auto const at = [&](size_t index) {
+    return existing.begin() + static_cast<std::ptrdiff_t>(index);
+  };
+  auto const first = collided.front();
+  auto const last = collided.back() + 1;
+  if (last - first == collided.size()) {
+    // the parts of a broken subtitle (one that ends before it starts) may be
+    // out of order, or go over the neighbours; those are dropped
+    auto kept = parts.begin();
+    for (auto& part : parts) {
+      if ((kept == parts.begin() ? first != 0 && !(existing[first - 1] < part)
+                                 : !(*std::prev(kept) < part)) ||
+          (last != existing.size() && !(part < existing[last])))
+        continue;
+      if (&*kept != &part)
+        *kept = std::move(part);
+      ++kept;
+    }
+    parts.erase(kept, parts.end());
+    subtitles.replace(at(first), at(last), std::move(parts));
+    return;
   }
 
-  if (it != end && v.timestamps.to > it->timestamps.to) {
-    // inserting the last remmaning part
-    subtitles.emplace_hint(collided_subtitle,
-                           v.content,
-                           duration{it->timestamps.to, v.timestamps.to});
-  }
+  // the collided ones aren't next to each other when some of the subtitles
+  // were already on top of each other
+  for (auto it = collided.rbegin(); it != collided.rend(); ++it)
+    subtitles.erase(at(*it));
+  subtitles.insert(std::make_move_iterator(parts.begin()),
+                   std::make_move_iterator(parts.end()));
 }
 
 void document::put_subtitle(const subtitle& v,
@@ -239,12 +252,31 @@ void document::replace_subtitle(decltype(subtitles)::iterator it,
 }
 void document::replace_subtitle(decltype(subtitles)::iterator it,
                                 subtitle&& replacement) noexcept {
-  if (it != std::end(subtitles)) {
-    auto next = std::next(it);
-    subtitles.erase(it);
-    subtitles.emplace_hint(next, std::move(replacement));
+  if (it != std::end(subtitles))
+    subtitles.replace(it, std::move(replacement));
+}
+void document_builder::put_subtitle(subtitle&& v) {
+  auto const& subtitles = std::as_const(doc.subtitles);
+  auto const* last = !run.empty() ? &run.back()
+                     : subtitles.empty() ? nullptr
+                                         : &*subtitles.rbegin();
+
+  // put_subtitle would've only checked the last one too, and appended it
+  if (!last || in_order(last->timestamps, v.timestamps)) {
+    run.emplace_back(std::move(v));
+    return;
   }
+  flush();
+  doc.put_subtitle(std::move(v));
 }
+
+void document_builder::flush() {
+  // they're all after the last one, so this is an append
+  doc.subtitles.insert(std::make_move_iterator(run.begin()),
+                       std::make_move_iterator(run.end()));
+  run.clear();
+}
+
 document subman::merge(document const& sub1,
                        document const& sub2,
                        merge_method const& mm) noexcept {
@@ -258,9 +290,51 @@ document subman::merge(document const& sub1,
 void subman::merge_in_place(document& sub1,
                        document const& sub2,
                        merge_method const& mm) noexcept {
-  for (auto& v : sub2.subtitles) {
-    sub1.put_subtitle(v, mm);
+  if (&sub1 == &sub2) {
+    auto const copy = sub2;
+    return merge_in_place(sub1, copy, mm);
+  }
+
+  // sub2 comes in order, so its subtitles only collide with the ones in a
+  // window that moves along sub1; the ones that the window leaves behind are
+  // done, so nothing is inserted into the middle of the whole document
+  std::pmr::vector<subtitle> merged{sub1.subtitles.get_allocator()};
+  merged.reserve(sub1.subtitles.size() + sub2.subtitles.size());
+  document window;
+  auto next = sub1.subtitles.begin();
+  uint64_t reach = 0; // where the collisions can go
+  for (auto const& v : sub2.subtitles) {
+    // (a broken one may end before it starts)
+    reach = std::max({reach, v.timestamps.to, v.timestamps.from + 1});
+    for (auto const& sub : window.subtitles)
+      if (sub.timestamps.from < reach)
+        reach = std::max(reach, sub.timestamps.to);
+    for (; next != sub1.subtitles.end() && next->timestamps.from < reach;
+         ++next) {
+      reach = std::max(reach, next->timestamps.to);
+      window.subtitles.insert(std::move(*next));
+    }
+
+    auto done = window.subtitles.begin();
+    while (done != window.subtitles.end() &&
+           done->timestamps.to <= v.timestamps.from &&
+           done->timestamps.from < v.timestamps.from)
+      ++done;
+    merged.insert(merged.end(),
+                  std::make_move_iterator(window.subtitles.begin()),
+                  std::make_move_iterator(done));
+    window.subtitles.erase(window.subtitles.begin(), done);
+    window.put_subtitle(v, mm);
   }
+  merged.insert(merged.end(),
+                std::make_move_iterator(window.subtitles.begin()),
+                std::make_move_iterator(window.subtitles.end()));
+  merged.insert(merged.end(),
+                std::make_move_iterator(next),
+                std::make_move_iterator(sub1.subtitles.end()));
+  // (they're in its arena, so it can't just be cleared first)
+  sub1.subtitles.replace(
+      sub1.subtitles.cbegin(), sub1.subtitles.cend(), std::move(merged));
 }
 
 
@@ -273,36 +347,34 @@ void document::shift(size_t s) noexcept {
 }
 
 void document::shift(int64_t s) noexcept {
-  std::vector<subman::subtitle> subs(subtitles.begin(), subtitles.end());
   if (s < 0) {
-    for (auto& sub : subs)
+    for (auto& sub : subtitles)
       sub.timestamps.shift(s);
+    // the ones that went below zero are on top of each other now
+    subtitles.restore_order();
   } else {
-    for (auto& sub : subs)
+    for (auto& sub : subtitles)
       sub.timestamps.shift(static_cast<size_t>(s));
   }
-  subtitles = decltype(subtitles)(subs.begin(), subs.end());
 }
 
 void document::gap(size_t gdiff) noexcept {
   size_t diff;
-  auto finishline = std::prev(std::end(subtitles));
-  decltype(finishline) next;
   size_t each;
-  for (auto it = std::begin(subtitles); it != finishline; it++) {
-    next = std::next(it);
-    if (next != finishline) {
-      diff = static_cast<size_t>(static_cast<int64_t>(next->timestamps.from) -
-                                 static_cast<int64_t>(it->timestamps.to));
-      if (diff < gdiff) {
-        each = (gdiff - diff) / 2;
-        auto current_item = *it;
-        auto next_item = *next;
-        current_item.timestamps.to -= each;
-        next_item.timestamps.from += each;
-        replace_subtitle(it, std::move(current_item));
-        replace_subtitle(next, std::move(next_item));
-      }
+  for (size_t i = 0; i + 2 < subtitles.size(); i++) {
+    auto const& current = subtitles[i];
+    auto const& next = subtitles[i + 1];
+    diff = static_cast<size_t>(static_cast<int64_t>(next.timestamps.from) -
+                               static_cast<int64_t>(current.timestamps.to));
+    if (diff < gdiff) {
+      each = (gdiff - diff) / 2;
+      subtitles[i].timestamps.to -= each;
+
+      // the start of the next one moves, so it may have to move too
+      auto next_item = next;
+      next_item.timestamps.from += each;
+      subtitles.replace(subtitles.begin() + static_cast<std::ptrdiff_t>(i + 1),
+                        std::move(next_item));
     }
   }
 }
@@ -310,7 +382,7 @@ void document::gap(size_t gdiff) noexcept {
 document document::matches(std::string const& keyword) const noexcept {
   document doc;
   for (auto const& sub : subtitles)
-    if (sub.content.cget_content() == keyword)
+    if (sub.content.cget_content() == std::string_view{keyword})
       doc.subtitles.insert(sub);
   return doc;
 }
@@ -4,8 +4,8 @@
 #include "duration.h"
 #include "styledstring.h"
 #include "subtitle.h"
+#include "subtitle_list.h"
 #include <functional>
-#include <set>
 #include <vector>
 
 /**
@@ -43,7 +43,7 @@ namespace subman {
    * use put_subtitle insead of directly modifing the subtitles
    */
   struct document {
-    std::set<subtitle> subtitles;
+    subtitle_list subtitles;
 
     document() = default;
     void put_subtitle(subtitle const& v, merge_method const& mm = {}) noexcept;
@@ -74,6 +74,35 @@ namespace subman {
     document regex(std::string const& pattern ) const noexcept;
   };
 
+  /**
+   * @brief builds a document out of subtitles that come in file order
+   * Nearly all the files are already sorted and free of collisions, so the
+   * subtitles are collected while they keep coming in order and are then
+   * inserted in one linear bulk insert. Only the ones that break the order go
+   * through the collision resolving put_subtitle.
+   * Call "flush" when there's no more subtitles.
+   */
+  class document_builder {
+    document& doc;
+    std::vector<subtitle> run;
+
+  public:
+    explicit document_builder(document& doc) noexcept : doc{doc} {
+    }
+
+    void put_subtitle(subtitle&& v);
+    void flush();
+
+    /**
+     * @brief whether "next" can simply go after "last"; otherwise the
+     * collisions have to be resolved
+     */
+    static bool in_order(duration const& last,
+                         duration const& next) noexcept {
+      return next.from > last.from && next.from >= last.to;
+    }
+  };
+
   /**
    * @brief merge two subtitles together
    * @param sub1
@@ -1,4 +1,5 @@
 #include "duration.h"
+#include <charconv>
 #include <utility>
 
 using namespace subman;
@@ -65,3 +66,104 @@ void swap(duration& a, duration& b) noexcept {
   swap(a.from, b.from);
   swap(a.to, b.to);
 }
+
+namespace {
+
+  // the decimals that mean the rates of NTSC
+  struct ntsc_rate {
+    std::string_view decimal;
+    subman::framerate fps;
+  };
+  constexpr ntsc_rate ntsc_rates[] = {{"23.976", {24000, 1001}},
+                                      {"23.98", {24000, 1001}},
+                                      {"29.97", {30000, 1001}},
+                                      {"47.952", {48000, 1001}},
+                                      {"59.94", {60000, 1001}},
+                                      {"119.88", {120000, 1001}}};
+
+  bool parse_number(std::string_view str, uint64_t& value) noexcept {
+    auto const [end, error] =
+        std::from_chars(str.data(), str.data() + str.size(), value);
+    return error == std::errc{} && end == str.data() + str.size();
+  }
+
+} // namespace
+
+std::optional<framerate> subman::to_framerate(std::string_view str) noexcept {
+  while (!str.empty() && (str.front() == ' ' || str.front() == '\t'))
+    str.remove_prefix(1);
+  while (!str.empty() && (str.back() == ' ' || str.back() == '\t' ||
+                          str.back() == '\r'))
+    str.remove_suffix(1);
+  for (auto const& rate : ntsc_rates)
+    if (str == rate.decimal)
+      return rate.fps;
+
+  framerate fps{0, 1};
+  if (auto const slash = str.find('/'); slash != std::string_view::npos) {
+    if (!parse_number(str.substr(0, slash), fps.num) ||
+        !parse_number(str.substr(slash + 1), fps.den))
+      return std::nullopt;
+  } else if (auto const dot = str.find('.'); dot != std::string_view::npos) {
+    // "25.5" is 255/10
+    auto const decimals = str.substr(dot + 1);
+    uint64_t whole = 0, fraction = 0;
+    if ((dot != 0 && !parse_number(str.substr(0, dot), whole)) ||
+        decimals.empty() || decimals.size() > 6 ||
+        !parse_number(decimals, fraction))
+      return std::nullopt;
+    for (size_t i = 0; i < decimals.size(); ++i)
+      fps.den *= 10;
+    fps.num = whole * fps.den + fraction;
+  } else if (!parse_number(str, fps.num)) {
+    return std::nullopt;
+  }
+  if (fps.num == 0 || fps.den == 0)
+    return std::nullopt;
+  return fps;
+}
+
+std::string subman::to_string(framerate const& fps) {
+  // rounded to three decimals, without the trailing zeros
+  auto const thousandths = (fps.num * 1000 + fps.den / 2) / fps.den;
+  auto str = std::to_string(thousandths / 1000);
+  if (auto fraction = thousandths % 1000; fraction != 0) {
+    str += '.';
+    for (uint64_t unit = 100; fraction != 0; unit /= 10) {
+      str += static_cast<char>('0' + fraction / unit);
+      fraction %= unit;
+    }
+  }
+  return str;
+}
+
+void subman::frames_to_milliseconds(std::span<uint64_t> values,
+                                    framerate const& fps) noexcept {
+  auto const scale = 1000 * fps.den, divisor = fps.num,
+             half = divisor / 2;
+  for (auto& value : values)
+    value = (value * scale + half) / divisor;
+}
+
+void subman::milliseconds_to_frames(std::span<uint64_t> values,
+                                    framerate const& fps) noexcept {
+  auto const scale = fps.num, divisor = 1000 * fps.den,
+             half = divisor / 2;
+  for (auto& value : values)
+    value = (value * scale + half) / divisor;
+}
+
+duration duration::from_frames(uint64_t first,
+                               uint64_t last,
+                               framerate const& fps) noexcept {
+  uint64_t values[] = {first, last};
+  frames_to_milliseconds(values, fps);
+  return {values[0], values[1]};
+}
+
+std::pair<uint64_t, uint64_t>
+duration::to_frames(framerate const& fps) const noexcept {
+  uint64_t values[] = {from, to};
+  milliseconds_to_frames(values, fps);
+  return {values[0], values[1]};
+}
@@ -2,9 +2,42 @@
 #define DURATION_H
 
 #include <chrono>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
 
 namespace subman {
 
+  /**
+   * @brief frames per second, as an exact fraction (like 24000/1001)
+   */
+  struct framerate {
+    uint64_t num = 24000;
+    uint64_t den = 1001;
+  };
+
+  /**
+   * @brief parses "25", "23.976" or "24000/1001"; the usual NTSC rates
+   * ("23.976", "29.97", ...) are taken as their exact fractions
+   */
+  std::optional<framerate> to_framerate(std::string_view str) noexcept;
+
+  // "23.976"; at most three decimals
+  std::string to_string(framerate const& fps);
+
+  /**
+   * @brief converts the frame numbers into milliseconds (or back) in place,
+   * rounded to the nearest; a frame that goes to milliseconds and back comes
+   * back as the same frame for any rate up to 1000 fps
+   */
+  void frames_to_milliseconds(std::span<uint64_t> values,
+                              framerate const& fps) noexcept;
+  void milliseconds_to_frames(std::span<uint64_t> values,
+                              framerate const& fps) noexcept;
+
   /**
    * @brief The duration struct
    */
@@ -21,6 +54,14 @@ namespace subman {
     // copy constructor
     duration(duration const& d) : from(d.from), to(d.to) {
     }
+    duration& operator=(duration const&) = default;
+
+    // the time of the frames "first" to "last" (the frame numbers)
+    static duration from_frames(uint64_t first,
+                                uint64_t last,
+                                framerate const& fps) noexcept;
+    std::pair<uint64_t, uint64_t>
+    to_frames(framerate const& fps) const noexcept;
 
     void reset() noexcept;
     void shift(int64_t n) noexcept;
@@ -0,0 +1,352 @@
+#include "encoding.h"
+#include <bit>
+#include <cstdint>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SUBMAN_SSSE3_DISPATCH
+#include <tmmintrin.h>
+#endif
+
+using subman::text_encoding;
+using subman::utf8_text;
+
+namespace {
+
+  constexpr std::string_view replacement_character = "\xEF\xBF\xBD";
+
+  /**
+   * @return the length of the valid UTF-8 sequence at "p", or 0 if it's not
+   * valid (truncated, overlong, a surrogate or out of the Unicode range)
+   */
+  size_t sequence_length(unsigned char const* p,
+                         unsigned char const* end) noexcept {
+    auto const lead = p[0];
+    size_t len;
+    uint32_t code_point;
+    if (lead < 0x80)
+      return 1;
+    if ((lead & 0xE0) == 0xC0) {
+      len = 2;
+      code_point = lead & 0x1Fu;
+    } else if ((lead & 0xF0) == 0xE0) {
+      len = 3;
+      code_point = lead & 0x0Fu;
+    } else if ((lead & 0xF8) == 0xF0) {
+      len = 4;
+      code_point = lead & 0x07u;
+    } else {
+      return 0;
+    }
+    if (static_cast<size_t>(end - p) < len)
+      return 0;
+    for (size_t i = 1; i < len; ++i) {
+      if ((p[i] & 0xC0) != 0x80)
+        return 0;
+      code_point = (code_point << 6) | (p[i] & 0x3Fu);
+    }
+    switch (len) {
+    case 2:
+      return code_point >= 0x80 ? len : 0;
+    case 3:
+      return code_point >= 0x800 &&
+                     (code_point < 0xD800 || code_point > 0xDFFF)
+                 ? len
+                 : 0;
+    default:
+      return code_point >= 0x10000 && code_point <= 0x10FFFF ? len : 0;
+    }
+  }
+
+#ifdef SUBMAN_SSSE3_DISPATCH
+  /**
+   * @brief skips the valid UTF-8 with no lone carriage return, 16 bytes at a
+   * time, whatever the script
+   * The sequences are checked with the three nibble lookup tables of Keiser
+   * and Lemire ("Validating UTF-8 In Less Than One Instruction Per Byte"),
+   * and a CR is lone when the byte after it is not a LF.
+   * @return the start of the first block that has a problem (or of the bytes
+   * that don't fill a block), moved back to the start of the sequence or the
+   * CR that runs into it; the scalar check goes on from there
+   */
+  __attribute__((target("ssse3"))) unsigned char const*
+  skip_clean_ssse3(unsigned char const* begin,
+                   unsigned char const* end) noexcept {
+    // the errors that each nibble can be part of
+    constexpr char too_short = 1 << 0;
+    constexpr char too_long = 1 << 1;
+    constexpr char overlong_3 = 1 << 2;
+    constexpr char too_large = 1 << 3;
+    constexpr char surrogate = 1 << 4;
+    constexpr char overlong_2 = 1 << 5;
+    constexpr char too_large_1000 = 1 << 6;
+    constexpr char overlong_4 = 1 << 6;
+    constexpr char two_conts = static_cast<char>(1 << 7);
+    constexpr char carry = too_short | too_long | two_conts;
+
+    auto const first_high = _mm_setr_epi8(
+        too_long, too_long, too_long, too_long, // ASCII
+        too_long, too_long, too_long, too_long,
+        two_conts, two_conts, two_conts, two_conts, // continuation
+        too_short | overlong_2,                     // 2 byte lead
+        too_short,
+        too_short | overlong_3 | surrogate, // 3 byte lead
+        too_short | too_large | too_large_1000 | overlong_4); // 4 byte lead
+    auto const first_low = _mm_setr_epi8(
+        carry | overlong_3 | overlong_2 | overlong_4,
+        carry | overlong_2,
+        carry,
+        carry,
+        carry | too_large,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000 | surrogate,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000);
+    auto const second_high = _mm_setr_epi8(
+        too_short, too_short, too_short, too_short, // ASCII
+        too_short, too_short, too_short, too_short,
+        too_long | overlong_2 | two_conts | overlong_3 | too_large_1000 |
+            overlong_4, // 1000____
+        too_long | overlong_2 | two_conts | overlong_3 | too_large,
+        too_long | overlong_2 | two_conts | surrogate | too_large,
+        too_long | overlong_2 | two_conts | surrogate | too_large,
+        too_short, too_short, too_short, too_short); // lead
+
+    auto const nibbles = _mm_set1_epi8(0x0F);
+    auto const high_nibbles = [&](__m128i bytes) {
+      return _mm_and_si128(_mm_srli_epi16(bytes, 4), nibbles);
+    };
+
+    auto prev = _mm_setzero_si128();
+    auto it = begin;
+    for (; end - it >= 16; it += 16) {
+      auto const block = _mm_loadu_si128(reinterpret_cast<__m128i const*>(it));
+      auto const prev1 = _mm_alignr_epi8(block, prev, 15);
+      auto const prev2 = _mm_alignr_epi8(block, prev, 14);
+      auto const prev3 = _mm_alignr_epi8(block, prev, 13);
+
+      auto const special = _mm_and_si128(
+          _mm_and_si128(_mm_shuffle_epi8(first_high, high_nibbles(prev1)),
+                        _mm_shuffle_epi8(first_low,
+                                         _mm_and_si128(prev1, nibbles))),
+          _mm_shuffle_epi8(second_high, high_nibbles(block)));
+      // the third and the fourth bytes of the 3 and 4 byte sequences
+      auto const continued = _mm_and_si128(
+          _mm_or_si128(_mm_subs_epu8(prev2, _mm_set1_epi8(0xE0 - 0x80)),
+                       _mm_subs_epu8(prev3, _mm_set1_epi8(0xF0 - 0x80))),
+          _mm_set1_epi8(static_cast<char>(0x80)));
+      auto const lone_cr = _mm_andnot_si128(
+          _mm_cmpeq_epi8(block, _mm_set1_epi8('\n')),
+          _mm_cmpeq_epi8(prev1, _mm_set1_epi8('\r')));
+      auto const error =
+          _mm_or_si128(_mm_xor_si128(continued, special), lone_cr);
+      if (_mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) !=
+          0xFFFF)
+        break;
+      prev = block;
+    }
+
+    // the sequence that runs into "it" was only checked up to there
+    auto resume = it;
+    while (resume != begin && it - resume < 3 && (resume[-1] & 0xC0) == 0x80)
+      --resume;
+    if (resume != begin && (resume[-1] >= 0xC0 || resume[-1] == '\r'))
+      --resume;
+    return resume;
+  }
+
+  bool has_ssse3() noexcept {
+    static bool const supported = __builtin_cpu_supports("ssse3");
+    return supported;
+  }
+#endif
+
+  /**
+   * @brief finds the first byte that makes us rewrite the text: the start of
+   * an invalid sequence or a carriage return that is not followed by a line
+   * feed (CRLF is left alone; the readers trim the CR anyway)
+   * When the CPU has SSSE3, the text is validated 16 bytes at a time up to
+   * the first problem; the rest (or all of it, on the other CPUs) is checked
+   * one sequence at a time, skipping the plain ASCII blocks with SSE2.
+   * @return the position of that byte, or the size of the text
+   */
+  size_t find_unclean(std::string_view text) noexcept {
+    auto const begin = reinterpret_cast<unsigned char const*>(text.data());
+    auto const end = begin + text.size();
+    auto it = begin;
+#ifdef SUBMAN_SSSE3_DISPATCH
+    if (has_ssse3())
+      it = skip_clean_ssse3(begin, end);
+#endif
+    while (it < end) {
+#ifdef __SSE2__
+      // skipping the ASCII blocks that have no carriage return
+      if (end - it >= 16) {
+        auto const block =
+            _mm_loadu_si128(reinterpret_cast<__m128i const*>(it));
+        auto const mask = static_cast<unsigned>(
+            _mm_movemask_epi8(block) |
+            _mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8('\r'))));
+        if (mask == 0) {
+          it += 16;
+          continue;
+        }
+        it += std::countr_zero(mask);
+      }
+#endif
+      if (*it == '\r') {
+        if (it + 1 == end || it[1] != '\n')
+          return static_cast<size_t>(it - begin);
+        it += 2;
+      } else if (*it < 0x80) {
+        ++it;
+      } else if (auto const len = sequence_length(it, end)) {
+        it += len;
+      } else {
+        return static_cast<size_t>(it - begin);
+      }
+    }
+    return text.size();
+  }
+
+  void append_utf8(std::string& out, uint32_t code_point) {
+    if (code_point < 0x80) {
+      out += static_cast<char>(code_point);
+    } else if (code_point < 0x800) {
+      out += static_cast<char>(0xC0 | (code_point >> 6));
+      out += static_cast<char>(0x80 | (code_point & 0x3F));
+    } else if (code_point < 0x10000) {
+      out += static_cast<char>(0xE0 | (code_point >> 12));
+      out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+      out += static_cast<char>(0x80 | (code_point & 0x3F));
+    } else {
+      out += static_cast<char>(0xF0 | (code_point >> 18));
+      out += static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+      out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+      out += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+  }
+
+  /**
+   * @brief copies the UTF-8 text into "out", replacing the invalid sequences
+   * and folding the line endings
+   */
+  size_t rewrite_utf8(std::string_view text, std::string& out) {
+    auto const begin = reinterpret_cast<unsigned char const*>(text.data());
+    auto const end = begin + text.size();
+    size_t invalid = 0;
+    for (auto it = begin; it < end;) {
+      if (*it == '\r') {
+        out += '\n';
+        it += (it + 1 != end && it[1] == '\n') ? 2 : 1;
+      } else if (*it < 0x80) {
+        out += static_cast<char>(*it++);
+      } else if (auto const len = sequence_length(it, end)) {
+        out.append(reinterpret_cast<char const*>(it), len);
+        it += len;
+      } else {
+        out.append(replacement_character);
+        ++invalid;
+        ++it;
+      }
+    }
+    return invalid;
+  }
+
+  /**
+   * @brief transcodes UTF-16 into UTF-8, folding the line endings
+   * @return the number of unpaired surrogates (and a dangling odd byte)
+   */
+  size_t
+  transcode_utf16(std::string_view raw, bool big_endian, std::string& out) {
+    auto const bytes = reinterpret_cast<unsigned char const*>(raw.data());
+    auto const units = raw.size() / 2;
+    auto const unit = [&](size_t i) -> uint32_t {
+      return big_endian ? (bytes[2 * i] << 8) | bytes[2 * i + 1]
+                        : (bytes[2 * i + 1] << 8) | bytes[2 * i];
+    };
+
+    size_t invalid = raw.size() % 2;
+    out.reserve(out.size() + units * 3 / 2);
+    for (size_t i = 0; i < units;) {
+      auto code_point = unit(i++);
+      if (code_point >= 0xD800 && code_point <= 0xDBFF && i < units &&
+          unit(i) >= 0xDC00 && unit(i) <= 0xDFFF) {
+        code_point =
+            0x10000 + ((code_point - 0xD800) << 10) + (unit(i++) - 0xDC00);
+      } else if (code_point >= 0xD800 && code_point <= 0xDFFF) {
+        out.append(replacement_character);
+        ++invalid;
+        continue;
+      }
+      if (code_point == '\r') {
+        out += '\n';
+        if (i < units && unit(i) == '\n')
+          ++i;
+        continue;
+      }
+      append_utf8(out, code_point);
+    }
+    if (raw.size() % 2)
+      out.append(replacement_character);
+    return invalid;
+  }
+
+} // namespace
+
+text_encoding subman::detect_encoding(std::string_view raw,
+                                      size_t& bom_size) noexcept {
+  bom_size = 0;
+  if (raw.starts_with("\xEF\xBB\xBF")) {
+    bom_size = 3;
+    return text_encoding::UTF8;
+  }
+  if (raw.starts_with("\xFF\xFE")) {
+    bom_size = 2;
+    return text_encoding::UTF16LE;
+  }
+  if (raw.starts_with("\xFE\xFF")) {
+    bom_size = 2;
+    return text_encoding::UTF16BE;
+  }
+
+  // subtitles start with ASCII (an index, a header or a timestamp)
+  if (raw.size() >= 2) {
+    if (raw[0] != '\0' && raw[1] == '\0')
+      return text_encoding::UTF16LE;
+    if (raw[0] == '\0' && raw[1] != '\0')
+      return text_encoding::UTF16BE;
+  }
+  return text_encoding::UTF8;
+}
+
+utf8_text::utf8_text(std::string_view raw) {
+  size_t bom_size;
+  auto const encoding = detect_encoding(raw, bom_size);
+  raw.remove_prefix(bom_size);
+
+  if (encoding != text_encoding::UTF8) {
+    invalid =
+        transcode_utf16(raw, encoding == text_encoding::UTF16BE, storage);
+    rewritten = true;
+    return;
+  }
+
+  input = raw;
+  if (find_unclean(raw) == raw.size())
+    return; // it's clean; no copies needed
+
+  storage.reserve(raw.size() + raw.size() / 16);
+  invalid = rewrite_utf8(raw, storage);
+  rewritten = true;
+}
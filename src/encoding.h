@@ -0,0 +1,54 @@
+#ifndef ENCODING_H
+#define ENCODING_H
+
+#include <string>
+#include <string_view>
+
+namespace subman {
+
+  enum class text_encoding { UTF8, UTF16LE, UTF16BE };
+
+  /**
+   * @brief detects the encoding from the BOM, or from the zero bytes that
+   * UTF-16 puts next to ASCII characters when there's no BOM
+   * @param raw the first bytes of the input
+   * @param bom_size the size of the BOM, if there's one
+   */
+  text_encoding detect_encoding(std::string_view raw,
+                                size_t& bom_size) noexcept;
+
+  /**
+   * @brief The input text, normalized to valid UTF-8
+   *
+   * The BOM is stripped and UTF-16 is transcoded. Invalid sequences are
+   * replaced with U+FFFD and counted. Lone carriage returns become line
+   * feeds.
+   *
+   * Clean UTF-8 input (nearly all subtitles) is only validated, and the view
+   * points into the original input; it's validated 16 bytes at a time with
+   * SSSE3 when the CPU has it, and a character at a time otherwise. The input
+   * is rewritten (and CRLF folded into LF along the way) only when it's
+   * needed.
+   * So the input should outlive this object.
+   */
+  class utf8_text {
+    std::string_view input;
+    std::string storage;
+    bool rewritten = false;
+    size_t invalid = 0;
+
+  public:
+    explicit utf8_text(std::string_view raw);
+
+    auto view() const noexcept -> std::string_view {
+      return rewritten ? std::string_view{storage} : input;
+    }
+
+    auto invalid_sequences() const noexcept -> size_t {
+      return invalid;
+    }
+  };
+
+} // namespace subman
+
+#endif // ENCODING_H
@@ -0,0 +1,743 @@
+#include "ass.h"
+#include "../encoding.h"
+#include "cue_text.h"
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <memory_resource>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+using namespace subman::formats;
+using subman::styledstring;
+
+namespace {
+
+  constexpr auto npos = std::string_view::npos;
+
+  // more than any "Format:" line has (the v4+ styles have 23)
+  constexpr size_t max_fields = 32;
+  using field_list = std::array<std::string_view, max_fields>;
+
+  /**
+   * @brief splits the comma-separated fields of a line, without copying
+   * them; the last one gets the rest of the line, since the text of a
+   * dialogue may have commas in it
+   * @return the number of the fields
+   */
+  size_t split_fields(std::string_view line,
+                      size_t count,
+                      field_list& fields) noexcept {
+    count = std::min(count, max_fields);
+    size_t n = 0;
+    while (n + 1 < count) {
+      auto const comma = line.find(',');
+      if (comma == npos)
+        break;
+      fields[n++] = trim(line.substr(0, comma));
+      line.remove_prefix(comma + 1);
+    }
+    fields[n++] = trim(line);
+    return n;
+  }
+
+  /**
+   * @brief where the fields that we care about are in the lines of a section
+   */
+  struct columns {
+    size_t count = 0;
+    size_t name = npos, fontsize = npos, color = npos, bold = npos,
+           italic = npos, underline = npos;
+    size_t start = npos, end = npos, style = npos, text = npos;
+
+    explicit columns(std::string_view format) noexcept {
+      field_list names;
+      count = split_fields(format, max_fields, names);
+      for (size_t i = 0; i < count; ++i) {
+        auto const& column = names[i];
+        if (iequals(column, "name"))
+          name = i;
+        else if (iequals(column, "fontsize"))
+          fontsize = i;
+        else if (iequals(column, "primarycolour"))
+          color = i;
+        else if (iequals(column, "bold"))
+          bold = i;
+        else if (iequals(column, "italic"))
+          italic = i;
+        else if (iequals(column, "underline"))
+          underline = i;
+        else if (iequals(column, "start"))
+          start = i;
+        else if (iequals(column, "end"))
+          end = i;
+        else if (iequals(column, "style"))
+          style = i;
+        else if (iequals(column, "text"))
+          text = i;
+      }
+    }
+
+    static std::string_view get(field_list const& fields,
+                                size_t n,
+                                size_t column) noexcept {
+      return column < n ? fields[column] : std::string_view{};
+    }
+  };
+
+  // the columns that are used when a section has no "Format:" line
+  constexpr std::string_view default_style_format =
+      "Name, Fontname, Fontsize, PrimaryColour, SecondaryColour, "
+      "OutlineColour, BackColour, Bold, Italic, Underline, StrikeOut, "
+      "ScaleX, ScaleY, Spacing, Angle, BorderStyle, Outline, Shadow, "
+      "Alignment, MarginL, MarginR, MarginV, Encoding";
+  constexpr std::string_view default_event_format =
+      "Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, "
+      "Text";
+
+  /**
+   * @brief "&HAABBGGRR&", "&HBBGGRR" or the decimal colors of SSA, as
+   * "#rrggbb"
+   */
+  std::optional<std::string> parse_color(std::string_view color) {
+    color = trim(color);
+    int base = 10;
+    if (color.size() > 1 && color[0] == '&' && (color[1] | 0x20) == 'h') {
+      color.remove_prefix(2);
+      base = 16;
+    }
+    while (color.ends_with('&'))
+      color.remove_suffix(1);
+    uint64_t value = 0;
+    auto const [end, error] = std::from_chars(
+        color.data(), color.data() + color.size(), value, base);
+    if (error != std::errc{} || end != color.data() + color.size() ||
+        color.empty())
+      return std::nullopt;
+    return to_html_color(from_bgr(value));
+  }
+
+  /**
+   * @brief "H:MM:SS.cc" in milliseconds
+   */
+  std::optional<uint64_t> to_milliseconds(std::string_view str) noexcept {
+    size_t i = 0;
+    auto const number = [&](uint64_t& value) {
+      auto const begin = i;
+      for (; i < str.size() && is_digit(str[i]); ++i)
+        value = value * 10 + static_cast<uint64_t>(str[i] - '0');
+      return i != begin;
+    };
+    uint64_t hours = 0, minutes = 0, seconds = 0, millis = 0;
+    if (!number(hours) || i >= str.size() || str[i++] != ':' ||
+        !number(minutes) || i >= str.size() || str[i++] != ':' ||
+        !number(seconds))
+      return std::nullopt;
+    if (i < str.size() && str[i] == '.') {
+      // the fraction is usually in centiseconds
+      uint64_t unit = 100;
+      for (++i; i < str.size() && is_digit(str[i]); ++i, unit /= 10)
+        millis += static_cast<uint64_t>(str[i] - '0') * unit;
+    }
+    if (i != str.size())
+      return std::nullopt;
+    return ((hours * 60 + minutes) * 60 + seconds) * 1000 + millis;
+  }
+
+  bool is_on(std::string_view flag) noexcept {
+    return !flag.empty() && flag != "0";
+  }
+
+  struct ass_style {
+    bool bold = false, italic = false, underline = false;
+    std::string color, fontsize;
+  };
+
+  // the attributes that the override tags turn on and off
+  enum override_kind : size_t {
+    bold_kind,
+    italic_kind,
+    underline_kind,
+    color_kind,
+    fontsize_kind,
+    override_kinds
+  };
+  constexpr std::string_view kind_names[] = {
+      "b", "i", "u", "color", "fontsize"};
+  constexpr subman::attr_kind attr_kinds[] = {subman::attr_kind::bold,
+                                              subman::attr_kind::italic,
+                                              subman::attr_kind::underline,
+                                              subman::attr_kind::color,
+                                              subman::attr_kind::fontsize};
+
+  /**
+   * @brief turns the text of a dialogue into a styledstring
+   */
+  class text_lexer {
+    struct open_override {
+      bool open = false;
+      size_t start = 0;
+      std::string value;
+    };
+
+    std::pmr::string content;
+    subman::attr_list attrs;
+    std::array<open_override, override_kinds> overrides;
+    bool drawing = false; // "\p1" draws shapes with the text
+
+    void close(size_t kind) {
+      auto& o = overrides[kind];
+      if (o.open && o.start < content.size())
+        attrs.emplace_back(
+            subman::range{o.start, content.size()}, attr_kinds[kind], o.value);
+      o.open = false;
+    }
+
+    void open(size_t kind, std::string value = {}) {
+      if (overrides[kind].open && overrides[kind].value == value)
+        return;
+      close(kind);
+      overrides[kind] = {true, content.size(), std::move(value)};
+    }
+
+    // a flag like "\i1"; "\b" also takes the font weights
+    bool flag(std::string_view tag, char name, size_t kind) {
+      if (tag.empty() || tag[0] != name ||
+          (tag.size() > 1 && !is_digit(tag[1])))
+        return false;
+      unsigned weight = 0;
+      std::from_chars(tag.data() + 1, tag.data() + tag.size(), weight);
+      if (weight == 1 || weight >= 600)
+        open(kind);
+      else
+        close(kind);
+      return true;
+    }
+
+    void override_tag(std::string_view tag) {
+      if (flag(tag, 'b', bold_kind) || flag(tag, 'i', italic_kind) ||
+          flag(tag, 'u', underline_kind))
+        return;
+
+      if (tag == "c" || tag.starts_with("c&") || tag.starts_with("1c")) {
+        tag.remove_prefix(tag[0] == '1' ? 2 : 1);
+        if (tag.empty())
+          close(color_kind);
+        else if (auto color = parse_color(tag))
+          open(color_kind, std::move(*color));
+      } else if (tag.starts_with("fs") &&
+                 (tag.size() == 2 || is_digit(tag[2]))) {
+        tag.remove_prefix(2);
+        size_t digits = 0;
+        while (digits < tag.size() && is_digit(tag[digits]))
+          ++digits;
+        if (digits == 0)
+          close(fontsize_kind);
+        else
+          open(fontsize_kind, std::string{tag.substr(0, digits)});
+      } else if (tag.starts_with('p') &&
+                 (tag.size() == 1 || is_digit(tag[1]))) {
+        drawing = is_on(tag.substr(1));
+      } else if (tag.starts_with('r')) {
+        // back to the style
+        for (size_t kind = 0; kind < override_kinds; ++kind)
+          close(kind);
+      }
+      // the positions, the effects and such are dropped
+    }
+
+    void override_block(std::string_view block) {
+      for (auto i = block.find('\\'); i != npos;) {
+        auto const begin = ++i;
+        // the arguments in parentheses (like the ones of "\t") may have
+        // tags in them
+        while (i < block.size() && block[i] != '\\') {
+          if (block[i] == '(') {
+            auto const close = block.find(')', i);
+            i = close == npos ? block.size() : close + 1;
+          } else {
+            ++i;
+          }
+        }
+        override_tag(trim(block.substr(begin, i - begin)));
+        if (i >= block.size())
+          break;
+      }
+    }
+
+    void append(std::string_view text) {
+      if (!drawing)
+        content += text;
+    }
+
+  public:
+    // the styledstring is made with "alloc"
+    explicit text_lexer(styledstring::allocator_type const& alloc)
+        : content{alloc}, attrs{alloc} {
+    }
+
+    styledstring lex(std::string_view text,
+                     ass_style const& style,
+                     ass_style const& base) {
+      for (size_t i = 0; i < text.size();) {
+        auto const special = text.find_first_of("{\\", i);
+        if (special == npos) {
+          append(text.substr(i));
+          break;
+        }
+        append(text.substr(i, special - i));
+        i = special;
+        if (text[i] == '{') {
+          auto const end = text.find('}', i);
+          if (end == npos) {
+            append(text.substr(i));
+            break;
+          }
+          override_block(text.substr(i + 1, end - i - 1));
+          i = end + 1;
+          continue;
+        }
+        auto const next = i + 1 < text.size() ? text[i + 1] : '\0';
+        if (next == 'N') {
+          append("\n");
+        } else if (next == '{' || next == '}') {
+          append(text.substr(i + 1, 1));
+        } else if (next == 'n') {
+          append(" ");
+        } else if (next == 'h') {
+          append("\xC2\xA0"); // a no-break space
+        } else {
+          append("\\");
+          ++i;
+          continue;
+        }
+        i += 2;
+      }
+      // what's left of the removed tags and drawings at the end
+      while (!content.empty() && is_space(content.back()))
+        content.pop_back();
+      for (size_t kind = 0; kind < override_kinds; ++kind)
+        close(kind);
+      subman::erase_if(attrs, [&](subman::attr& a) {
+        a.pos.finish = std::min(a.pos.finish, content.size());
+        return a.pos.start >= a.pos.finish;
+      });
+
+      // the style covers the whole cue, under the overrides
+      subman::range const whole{0, content.size()};
+      if (!content.empty()) {
+        if (!style.fontsize.empty() && style.fontsize != base.fontsize)
+          attrs.emplace(attrs.begin(),
+                        whole,
+                        subman::attr_kind::fontsize,
+                        style.fontsize);
+        if (!style.color.empty() && style.color != base.color)
+          attrs.emplace(
+              attrs.begin(), whole, subman::attr_kind::color, style.color);
+        if (style.underline)
+          attrs.emplace(attrs.begin(), whole, subman::attr_kind::underline);
+        if (style.italic)
+          attrs.emplace(attrs.begin(), whole, subman::attr_kind::italic);
+        if (style.bold)
+          attrs.emplace(attrs.begin(), whole, subman::attr_kind::bold);
+      }
+      return styledstring{std::move(content), std::move(attrs)};
+    }
+  };
+
+  /**
+   * @brief the look of a whole cue, which the writer turns into a style
+   */
+  struct look {
+    bool bold = false, italic = false, underline = false;
+    std::string color, fontsize;
+
+    auto operator<=>(look const&) const = default;
+  };
+
+  bool is_number(std::string_view str) noexcept {
+    return !str.empty() &&
+           std::all_of(str.begin(), str.end(), [](char c) {
+             return is_digit(c);
+           });
+  }
+
+  /**
+   * @brief the kind of an attribute that ass can show; or override_kinds
+   */
+  size_t kind_of(subman::attr const& a) noexcept {
+    for (size_t kind = 0; kind < override_kinds; ++kind)
+      if (a.kind == attr_kinds[kind])
+        return kind;
+    return override_kinds;
+  }
+
+  bool is_whole(subman::attr const& a, size_t size) noexcept {
+    return a.pos.start == 0 && a.pos.finish >= size && size != 0;
+  }
+
+  look look_of(styledstring const& sstr) {
+    look l;
+    auto const size = sstr.cget_content().size();
+    for (auto const& a : sstr.cget_attrs()) {
+      if (!is_whole(a, size))
+        continue;
+      switch (kind_of(a)) {
+      case bold_kind:
+        l.bold = true;
+        break;
+      case italic_kind:
+        l.italic = true;
+        break;
+      case underline_kind:
+        l.underline = true;
+        break;
+      case color_kind:
+        if (l.color.empty() && to_rgb(a.value))
+          l.color = a.value;
+        break;
+      case fontsize_kind:
+        if (l.fontsize.empty() && is_number(a.value))
+          l.fontsize = a.value;
+        break;
+      default:
+        break;
+      }
+    }
+    return l;
+  }
+
+  /**
+   * @brief the attributes that the style of the cue doesn't already show
+   */
+  bool in_look(subman::attr const& a, look const& l, size_t size) noexcept {
+    if (!is_whole(a, size))
+      return false;
+    switch (kind_of(a)) {
+    case bold_kind:
+      return l.bold;
+    case italic_kind:
+      return l.italic;
+    case underline_kind:
+      return l.underline;
+    case color_kind:
+      return a.value == std::string_view{l.color};
+    case fontsize_kind:
+      return a.value == std::string_view{l.fontsize};
+    default:
+      return false;
+    }
+  }
+
+  void append_bgr(std::string& out, std::string const& color) {
+    subman::formats::append_bgr(
+        out, to_rgb(color).value_or(rgb_color{255, 255, 255}));
+  }
+
+  // "H:MM:SS.cc"
+  void append_ass_time(std::string& out, uint64_t millis) {
+    auto const centis = (millis + 5) / 10;
+    auto const two = [&](uint64_t value) {
+      out += static_cast<char>('0' + value / 10);
+      out += static_cast<char>('0' + value % 10);
+    };
+    append_number(out, centis / 360000);
+    out += ':';
+    two(centis / 6000 % 60);
+    out += ':';
+    two(centis / 100 % 60);
+    out += '.';
+    two(centis % 100);
+  }
+
+  void append_style(std::string& out, std::string_view name, look const& l) {
+    out += "Style: ";
+    out += name;
+    out += ",Arial,";
+    out += l.fontsize.empty() ? "20" : l.fontsize;
+    out += ",&H00";
+    append_bgr(out, l.color);
+    out += ",&H000000FF,&H00000000,&H00000000,";
+    out += l.bold ? "-1," : "0,";
+    out += l.italic ? "-1," : "0,";
+    out += l.underline ? "-1," : "0,";
+    out += "0,100,100,0,0,1,2,2,2,10,10,10,1\n";
+  }
+
+  void append_text(std::string& out, std::string_view text) {
+    for (size_t i = 0; i < text.size();) {
+      auto const special =
+          std::min(text.find_first_of("\n{}", i), text.size());
+      out.append(text, i, special - i);
+      if (special == text.size())
+        break;
+      if (text[special] == '\n') {
+        out += "\\N";
+      } else {
+        // the braces would start and end override blocks
+        out += '\\';
+        out += text[special];
+      }
+      i = special + 1;
+    }
+  }
+
+  /**
+   * @brief appends the text of a cue with the attributes that its style
+   * doesn't show as override tags
+   * Unlike the tags of html, the overrides are a state that each tag changes,
+   * so at each boundary of the attributes only what has changed is written.
+   * Of the attributes of a kind that are on at once, the one that started
+   * last wins.
+   */
+  void append_overridden(std::string& out,
+                         styledstring const& sstr,
+                         look const& style) {
+    auto const& content = sstr.cget_content();
+    struct edge {
+      size_t pos;
+      bool start;
+      subman::attr const* attribute;
+      size_t kind;
+    };
+    std::vector<edge> edges;
+    for (auto const& a : sstr.cget_attrs()) {
+      auto const kind = kind_of(a);
+      auto const finish = std::min(a.pos.finish, content.size());
+      if (kind == override_kinds || a.pos.start >= finish ||
+          in_look(a, style, content.size()))
+        continue;
+      if (kind == color_kind && !to_rgb(a.value))
+        continue;
+      if (kind == fontsize_kind && !is_number(a.value))
+        continue;
+      edges.push_back({a.pos.start, true, &a, kind});
+      edges.push_back({finish, false, &a, kind});
+    }
+    if (edges.empty()) {
+      append_text(out, content);
+      return;
+    }
+    std::stable_sort(
+        edges.begin(), edges.end(), [](auto const& a, auto const& b) {
+          return a.pos < b.pos;
+        });
+
+    std::array<std::vector<subman::attr const*>, override_kinds> active;
+    std::array<std::string, override_kinds> const styled{
+        style.bold ? "1" : "0",
+        style.italic ? "1" : "0",
+        style.underline ? "1" : "0",
+        style.color,
+        style.fontsize};
+    auto shown = styled;
+    size_t pos = 0;
+    for (size_t e = 0; e < edges.size();) {
+      auto const at = edges[e].pos;
+      append_text(out, std::string_view{content}.substr(pos, at - pos));
+      pos = at;
+      for (; e < edges.size() && edges[e].pos == at; ++e) {
+        auto& on = active[edges[e].kind];
+        if (edges[e].start)
+          on.push_back(edges[e].attribute);
+        else
+          std::erase(on, edges[e].attribute);
+      }
+      if (at == content.size())
+        break;
+
+      auto const block = out.size();
+      out += '{';
+      for (size_t kind = 0; kind < override_kinds; ++kind) {
+        auto const& on = active[kind];
+        std::string_view const value =
+            on.empty() ? styled[kind]
+            : kind < color_kind ? "1"
+                                : std::string_view{on.back()->value};
+        if (value == shown[kind])
+          continue;
+        shown[kind] = value;
+        out += '\\';
+        if (kind < color_kind) {
+          out += kind_names[kind];
+          out += value;
+        } else if (kind == color_kind) {
+          out += 'c';
+          if (!value.empty()) {
+            out += "&H";
+            append_bgr(out, shown[kind]);
+            out += '&';
+          }
+        } else {
+          out += "fs";
+          out += value;
+        }
+      }
+      if (out.size() == block + 1)
+        out.resize(block);
+      else
+        out += '}';
+    }
+    append_text(out, std::string_view{content}.substr(pos));
+  }
+
+} // namespace
+
+bool ass::sniff(std::string_view head) noexcept {
+  head = trim(head);
+  auto const first = trim(head.substr(0, head.find('\n')));
+  return iequals(first, "[script info]");
+}
+
+subman::document ass::read(std::istream& stream) noexcept(false) {
+  if (stream) {
+    std::string data{std::istreambuf_iterator<char>{stream}, {}};
+    subman::utf8_text text{data};
+    return read(text.view());
+  }
+  throw std::invalid_argument("Cannot read the content of the file.");
+}
+
+subman::document ass::read(std::string_view buffer) noexcept(false) {
+  enum class section { other, styles, events } in = section::other;
+  columns style_columns{default_style_format};
+  columns event_columns{default_event_format};
+  std::map<std::string, ass_style, std::less<>> styles;
+  ass_style const* base = nullptr;
+  static ass_style const plain;
+
+  subman::document doc;
+  subman::document_builder builder{doc};
+  field_list fields;
+  while (!buffer.empty()) {
+    auto const eol = std::min(buffer.find('\n'), buffer.size());
+    auto const line = trim(buffer.substr(0, eol));
+    buffer.remove_prefix(std::min(eol + 1, buffer.size()));
+    if (line.empty() || line[0] == ';')
+      continue;
+
+    if (line[0] == '[') {
+      if (iequals(line, "[v4+ styles]") || iequals(line, "[v4 styles]"))
+        in = section::styles;
+      else if (iequals(line, "[events]"))
+        in = section::events;
+      else
+        in = section::other;
+      continue;
+    }
+    auto const colon = line.find(':');
+    if (in == section::other || colon == npos)
+      continue;
+    auto const key = line.substr(0, colon);
+    auto const value = line.substr(colon + 1);
+
+    if (iequals(key, "format")) {
+      (in == section::styles ? style_columns : event_columns) =
+          columns{value};
+    } else if (in == section::styles && iequals(key, "style")) {
+      auto const& c = style_columns;
+      auto const n = split_fields(value, c.count, fields);
+      ass_style style;
+      style.bold = is_on(columns::get(fields, n, c.bold));
+      style.italic = is_on(columns::get(fields, n, c.italic));
+      style.underline = is_on(columns::get(fields, n, c.underline));
+      style.color =
+          parse_color(columns::get(fields, n, c.color)).value_or("");
+      style.fontsize = std::string{columns::get(fields, n, c.fontsize)};
+      auto const style_name = columns::get(fields, n, c.name);
+      auto& stored = styles[std::string{style_name}] = std::move(style);
+      if (!base || iequals(style_name, "default"))
+        base = &stored;
+    } else if (in == section::events && iequals(key, "dialogue")) {
+      auto const& c = event_columns;
+      auto const n = split_fields(value, c.count, fields);
+      auto const start = to_milliseconds(columns::get(fields, n, c.start));
+      auto const end = to_milliseconds(columns::get(fields, n, c.end));
+      if (!start || !end)
+        continue;
+      auto const found = styles.find(columns::get(fields, n, c.style));
+      auto const& style = found != styles.end() ? found->second
+                          : base                ? *base
+                                                : plain;
+      auto content = text_lexer{doc.subtitles.get_allocator()}.lex(
+          columns::get(fields, n, c.text), style, base ? *base : plain);
+      // the drawings and the empty lines are nothing to show
+      if (content.cget_content().empty())
+        continue;
+      builder.put_subtitle(
+          subman::subtitle{std::move(content), {*start, *end}});
+    }
+  }
+  builder.flush();
+  return doc;
+}
+
+void ass::write(subman::document const& sub,
+                std::ostream& out) noexcept(false) {
+  if (!out) {
+    throw std::invalid_argument("Cannot write data into stream");
+  }
+
+  // a style for each look that whole cues have; "Default" has none
+  std::map<look, size_t> looks{{look{}, 0}};
+  std::vector<look const*> table{&looks.begin()->first};
+  std::vector<size_t> cue_styles;
+  cue_styles.reserve(sub.subtitles.size());
+  for (auto const& v : sub.subtitles) {
+    auto const [it, added] =
+        looks.try_emplace(look_of(v.content), table.size());
+    if (added)
+      table.push_back(&it->first);
+    cue_styles.push_back(it->second);
+  }
+  auto const style_name = [](std::string& buffer, size_t index) {
+    if (index == 0) {
+      buffer += "Default";
+    } else {
+      buffer += "Style";
+      append_number(buffer, index);
+    }
+  };
+
+  std::string buffer =
+      "[Script Info]\n"
+      "ScriptType: v4.00+\n"
+      "WrapStyle: 0\n"
+      "ScaledBorderAndShadow: yes\n"
+      "\n"
+      "[V4+ Styles]\n"
+      "Format: ";
+  buffer += default_style_format;
+  buffer += '\n';
+  for (size_t i = 0; i < table.size(); ++i) {
+    std::string name;
+    style_name(name, i);
+    append_style(buffer, name, *table[i]);
+  }
+  buffer += "\n[Events]\nFormat: ";
+  buffer += default_event_format;
+  buffer += '\n';
+  buffer.reserve(write_block_size * 2);
+
+  auto style = cue_styles.begin();
+  for (auto const& v : sub.subtitles) {
+    buffer += "Dialogue: 0,";
+    append_ass_time(buffer, v.timestamps.from);
+    buffer += ',';
+    append_ass_time(buffer, v.timestamps.to);
+    buffer += ',';
+    style_name(buffer, *style);
+    buffer += ",,0,0,0,,";
+    append_overridden(buffer, v.content, *table[*style++]);
+    buffer += '\n';
+    if (buffer.size() >= write_block_size) {
+      out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+      buffer.clear();
+    }
+  }
+  out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+}
@@ -0,0 +1,43 @@
+#ifndef FORMAT_ASS_H
+#define FORMAT_ASS_H
+
+#include "../document.h"
+#include <istream>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace subman::formats {
+
+    /**
+     * @brief Advanced SubStation Alpha (and the older SubStation Alpha)
+     *
+     * The bold, italic and underline of a cue's style are put on the whole
+     * cue, and so are its color and font size when they are not the ones of
+     * the "Default" style. The override tags ("{\i1}", "{\b1}", "{\u1}",
+     * "{\c&HBBGGRR&}" and "{\fs}") become the same attributes; the rest of
+     * them (positions, effects and such) are dropped.
+     *
+     * The writer builds a style for each look that whole cues have, so only
+     * the attributes that cover a part of a cue are written as overrides.
+     */
+    class ass {
+    public:
+      static constexpr std::string_view name = "ass";
+      static constexpr std::string_view extensions[] = {".ass", ".ssa"};
+
+      ass() = delete;
+
+      /**
+       * @brief checks for the "[Script Info]" section at the top
+       */
+      static bool sniff(std::string_view head) noexcept;
+      static subman::document read(std::istream& stream) noexcept(false);
+      static subman::document read(std::string_view buffer) noexcept(false);
+      static void write(subman::document const& sub,
+                        std::ostream& out) noexcept(false);
+    };
+
+} // namespace subman::formats
+
+#endif // FORMAT_ASS_H
@@ -0,0 +1,43 @@
+#include "cue_reader.h"
+#include <bit>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+  /**
+   * @brief is the line that starts at "pos" empty or only whitespace
+   */
+  bool is_blank_line(std::string_view buffer, size_t pos) noexcept {
+    for (; pos < buffer.size() && buffer[pos] != '\n'; ++pos)
+      if (!subman::formats::is_space(buffer[pos]))
+        return false;
+    return true;
+  }
+
+} // namespace
+
+size_t subman::formats::find_blank_line(std::string_view buffer,
+                                        size_t from) noexcept {
+  auto i = from;
+#ifdef __SSE2__
+  auto const newline = _mm_set1_epi8('\n');
+  for (; i + 16 <= buffer.size(); i += 16) {
+    auto const block =
+        _mm_loadu_si128(reinterpret_cast<__m128i const*>(buffer.data() + i));
+    auto mask = static_cast<unsigned>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(block, newline)));
+    for (; mask != 0; mask &= mask - 1) {
+      auto const pos = i + static_cast<size_t>(std::countr_zero(mask)) + 1;
+      if (is_blank_line(buffer, pos))
+        return pos;
+    }
+  }
+#endif
+  for (; i < buffer.size(); ++i)
+    if (buffer[i] == '\n' && is_blank_line(buffer, i + 1))
+      return i + 1;
+  return buffer.size();
+}
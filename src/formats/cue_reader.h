@@ -0,0 +1,248 @@
+#ifndef FORMAT_CUE_READER_H
+#define FORMAT_CUE_READER_H
+
+#include "../document.h"
+#include "../encoding.h"
+#include "../generator.h"
+#include "cue_text.h"
+#include <algorithm>
+#include <future>
+#include <istream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * The reading machinery of the line-based formats (subrip and webvtt). A
+ * format only tells how its timing lines and its cue text look like, through
+ * a "Dialect":
+ *
+ *   static std::optional<cue_timing> timing(std::string_view line) noexcept;
+ *   static styledstring text(std::string_view text,
+ *                            std::string_view settings,
+ *                            styledstring::allocator_type const& alloc);
+ */
+namespace subman::formats {
+
+  /**
+   * @brief the state machine of the cues; it's fed one trimmed line at a time
+   *
+   * When the lines are views into "buffer" (the whole file), the text of a cue
+   * is kept as a span of that buffer and is only copied once, by the lexer,
+   * into its final place. Otherwise (or when the cue's lines are not next to
+   * each other), the lines are gathered in a string first.
+   *
+   * Every finished cue is handed to "sink"; its text is made with "alloc"
+   * (the arena of the document it goes in).
+   */
+  template <typename Dialect, typename Sink>
+  class cue_builder {
+    Sink& sink;
+    std::string_view buffer;
+    subman::styledstring::allocator_type alloc;
+    std::optional<subman::duration> dur;
+    std::string settings;
+    std::string_view span;
+    std::string spill;
+    bool spilled = false;
+    bool has_content = false;
+    bool previous_was_content = false;
+
+    bool in_buffer(std::string_view line) const noexcept {
+      return !buffer.empty() && line.data() >= buffer.data() &&
+             line.data() + line.size() <= buffer.data() + buffer.size();
+    }
+
+    void append(std::string_view line, bool contiguous) {
+      auto const stable = in_buffer(line);
+      if (!has_content && stable) {
+        span = line;
+      } else if (!spilled && stable && contiguous) {
+        span = {span.data(),
+                static_cast<size_t>(line.data() + line.size() - span.data())};
+      } else {
+        if (!spilled) {
+          spill.assign(span);
+          spilled = true;
+        }
+        if (has_content)
+          spill += '\n';
+        spill.append(line);
+      }
+      has_content = true;
+    }
+
+  public:
+    explicit cue_builder(
+        Sink& sink,
+        std::string_view buffer = {},
+        subman::styledstring::allocator_type const& alloc = {}) noexcept
+        : sink{sink}, buffer{buffer}, alloc{alloc} {
+    }
+
+    void feed(std::string_view line) {
+      auto const contiguous = std::exchange(previous_was_content, false);
+      if (line.empty()) {
+        flush();
+      } else if (auto timing = Dialect::timing(line)) {
+        dur = timing->timestamps;
+        settings.assign(timing->settings);
+      } else if (dur && !dur->is_zero()) {
+        append(line, contiguous);
+        previous_was_content = true;
+      }
+      // if it's not a valid duration, then it's a number, a header or a
+      // blank line which we just don't care.
+    }
+
+    void flush() {
+      if (dur && has_content) {
+        sink(subman::subtitle{
+            Dialect::text(spilled ? spill : span, settings, alloc), *dur});
+      }
+      dur.reset();
+      settings.clear();
+      span = {};
+      spill.clear();
+      spilled = has_content = previous_was_content = false;
+    }
+  };
+
+  /**
+   * @brief feeds every line of the buffer to the builder
+   */
+  template <typename Dialect, typename Sink>
+  void read_lines(std::string_view buffer,
+                  Sink& sink,
+                  subman::styledstring::allocator_type const& alloc = {}) {
+    cue_builder<Dialect, Sink> builder{sink, buffer, alloc};
+    for (auto rest = buffer; !rest.empty();) {
+      auto const line_end = rest.find('\n');
+      builder.feed(trim(rest.substr(0, line_end)));
+      rest.remove_prefix(line_end == std::string_view::npos ? rest.size()
+                                                            : line_end + 1);
+    }
+    builder.flush();
+  }
+
+  /**
+   * @brief finds the beginning of the first blank line after "from"
+   * Newlines are looked for 16 bytes at a time when SSE2 is available.
+   * @return the position of the blank line, or the size of the buffer
+   */
+  size_t find_blank_line(std::string_view buffer, size_t from) noexcept;
+
+  /**
+   * @brief parses the chunks of a big buffer on all the cores
+   * The chunks are split right at blank lines, where the state machine resets
+   * anyway, so no cue straddles two chunks. The cues are then put into the
+   * document in the same order the sequential reader would have put them,
+   * which gives identical results.
+   */
+  template <typename Dialect>
+  subman::document read_parallel(std::string_view buffer, size_t chunks) {
+    using cue_list = std::vector<subman::subtitle>;
+    std::vector<std::future<cue_list>> workers;
+    for (size_t i = 1, begin = 0; begin < buffer.size(); ++i) {
+      auto const target = std::max(begin, buffer.size() / chunks * i);
+      auto const end =
+          i >= chunks ? buffer.size() : find_blank_line(buffer, target);
+      auto const chunk = buffer.substr(begin, end - begin);
+      workers.emplace_back(std::async(std::launch::async, [chunk] {
+        cue_list cues;
+        auto sink = [&](subman::subtitle&& cue) {
+          cues.emplace_back(std::move(cue));
+        };
+        read_lines<Dialect>(chunk, sink);
+        return cues;
+      }));
+      begin = end;
+    }
+
+    subman::document doc;
+    subman::document_builder builder{doc};
+    // the workers' cues are on the heap, so they're copied into its arena
+    for (auto& worker : workers)
+      for (auto& cue : worker.get())
+        builder.put_subtitle(std::move(cue));
+    builder.flush();
+    return doc;
+  }
+
+  // smaller files are not worth the threads
+  constexpr size_t parallel_threshold = 4 * 1024 * 1024;
+  constexpr size_t min_chunk_size = 1024 * 1024;
+
+  /**
+   * @brief reads the cues of a whole (UTF-8) buffer into a document
+   */
+  template <typename Dialect>
+  subman::document read_cues(std::string_view buffer) {
+    if (buffer.size() >= parallel_threshold) {
+      auto const chunks =
+          std::min<size_t>(std::thread::hardware_concurrency(),
+                           buffer.size() / min_chunk_size);
+      if (chunks > 1)
+        return read_parallel<Dialect>(buffer, chunks);
+    }
+    subman::document doc;
+    subman::document_builder builder{doc};
+    auto sink = [&](subman::subtitle&& cue) {
+      builder.put_subtitle(std::move(cue));
+    };
+    read_lines<Dialect>(buffer, sink, doc.subtitles.get_allocator());
+    builder.flush();
+    return doc;
+  }
+
+  /**
+   * @brief yields the cues of the stream one by one
+   * The stream should be UTF-8; each line is validated on its own. The lines
+   * may end with LF, CRLF or CR, like in the buffers that "load" reads.
+   */
+  template <typename Dialect>
+  subman::generator<subman::subtitle> stream_cues(std::istream& stream) {
+    if (!stream)
+      throw std::invalid_argument("Cannot read the content of the file.");
+
+    // the cues that the builder has finished with the last line
+    std::vector<subman::subtitle> ready;
+    auto sink = [&](subman::subtitle&& cue) {
+      ready.emplace_back(std::move(cue));
+    };
+    cue_builder<Dialect, decltype(sink)> builder{sink};
+    std::string line;
+    for (;;) {
+      auto const more = static_cast<bool>(std::getline(stream, line));
+      if (more) {
+        // the CR of a CRLF; the lone ones are turned into LFs, since they
+        // end lines too (and a file with only CRs is all one "line" here)
+        std::string_view raw = line;
+        if (raw.ends_with('\r'))
+          raw.remove_suffix(1);
+        subman::utf8_text text{raw};
+        for (auto rest = text.view();;) {
+          auto const line_end = rest.find('\n');
+          builder.feed(trim(rest.substr(0, line_end)));
+          if (line_end == std::string_view::npos)
+            break;
+          rest.remove_prefix(line_end + 1);
+        }
+      } else {
+        builder.flush();
+      }
+      for (auto& cue : ready)
+        co_yield std::move(cue);
+      ready.clear();
+      if (!more)
+        break;
+    }
+  }
+
+} // namespace subman::formats
+
+#endif // FORMAT_CUE_READER_H
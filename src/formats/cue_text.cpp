@@ -0,0 +1,950 @@
+#include "cue_text.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <vector>
+
+using namespace subman::formats;
+using subman::attr_kind;
+using subman::styledstring;
+
+bool subman::formats::iequals(std::string_view str,
+                              std::string_view lowercase) noexcept {
+  if (str.size() != lowercase.size())
+    return false;
+  for (size_t i = 0; i < str.size(); ++i) {
+    auto c = str[i];
+    if (c >= 'A' && c <= 'Z')
+      c = static_cast<char>(c - 'A' + 'a');
+    if (c != lowercase[i])
+      return false;
+  }
+  return true;
+}
+
+std::string_view subman::formats::trim(std::string_view str) noexcept {
+  while (!str.empty() && is_space(str.front()))
+    str.remove_prefix(1);
+  while (!str.empty() && is_space(str.back()))
+    str.remove_suffix(1);
+  return str;
+}
+
+namespace {
+
+  /**
+   * @brief loads 8 bytes as a little-endian word, whatever the host order is
+   */
+  inline uint64_t load_le64(char const* p) noexcept {
+    uint64_t word;
+    std::memcpy(&word, p, sizeof(word));
+    if constexpr (std::endian::native == std::endian::big)
+      word = __builtin_bswap64(word);
+    return word;
+  }
+
+  /**
+   * @brief decodes "HH:MM:SS" with SWAR, 8 digits at a time
+   * @param p pointer to at least 8 readable bytes
+   * @param ms the decoded value in milliseconds
+   * @return false if the bytes are not in that exact shape
+   */
+  inline bool parse_hms(char const* p, uint64_t& ms) noexcept {
+    constexpr uint64_t colon_mask = 0x0000FF0000FF0000ull; // bytes 2 and 5
+    constexpr uint64_t colons = 0x00003A00003A0000ull;
+    constexpr uint64_t zeros = 0x0000300000300000ull;
+    constexpr uint64_t high_nibbles = 0xF0F0F0F0F0F0F0F0ull;
+
+    auto word = load_le64(p);
+    if ((word & colon_mask) != colons)
+      return false;
+
+    // the colons become '0' so we can check all the 8 bytes at once
+    word = (word & ~colon_mask) | zeros;
+    if (((word & high_nibbles) |
+         (((word + 0x0606060606060606ull) & high_nibbles) >> 4)) !=
+        0x3333333333333333ull)
+      return false;
+
+    // byte i becomes d[i] * 10 + d[i + 1]; hours, minutes and seconds end up
+    // in bytes 0, 3 and 6
+    word -= 0x3030303030303030ull;
+    word = word * 10 + (word >> 8);
+    auto const hour = word & 0xFF;
+    auto const min = (word >> 24) & 0xFF;
+    auto const sec = (word >> 48) & 0xFF;
+    ms = ((hour * 60 + min) * 60 + sec) * 1000;
+    return true;
+  }
+
+  /**
+   * @brief decodes the "HH:MM:SS,mmm" part (12 bytes) of a timestamp
+   */
+  inline bool parse_fixed_timestamp(char const* p,
+                                    char separator,
+                                    uint64_t& ms) noexcept {
+    if (!parse_hms(p, ms) || p[8] != separator || !is_digit(p[9]) ||
+        !is_digit(p[10]) || !is_digit(p[11]))
+      return false;
+    ms += static_cast<uint64_t>(p[9] - '0') * 100 +
+          static_cast<uint64_t>(p[10] - '0') * 10 +
+          static_cast<uint64_t>(p[11] - '0');
+    return true;
+  }
+
+  /**
+   * @brief the fast path of both formats: "HH:MM:SS,mmm --> HH:MM:SS,mmm"
+   * (29 characters) at the beginning of "str"
+   */
+  inline std::optional<subman::duration>
+  parse_fixed_duration(std::string_view str, char separator) noexcept {
+    constexpr size_t fixed_size = 29;
+    if (str.size() < fixed_size ||
+        (str.size() != fixed_size && is_digit(str[fixed_size])))
+      return std::nullopt;
+    uint64_t from, to;
+    auto const p = str.data();
+    if (parse_fixed_timestamp(p, separator, from) &&
+        std::memcmp(p + 12, " --> ", 5) == 0 &&
+        parse_fixed_timestamp(p + 17, separator, to))
+      return subman::duration{from, to};
+    return std::nullopt;
+  }
+
+  /**
+   * @brief reads a run of digits starting at "i"
+   * @return false if there's no digit or the number doesn't fit
+   */
+  bool read_number(std::string_view str, size_t& i, uint64_t& value) noexcept {
+    auto const begin = i;
+    value = 0;
+    for (; i < str.size() && is_digit(str[i]); ++i) {
+      if (i - begin == std::numeric_limits<uint64_t>::digits10)
+        return false; // it would overflow
+      value = value * 10 + static_cast<uint64_t>(str[i] - '0');
+    }
+    return i != begin;
+  }
+
+  /**
+   * @brief skips "\s* -+> \s*"
+   * @return false if the arrow is not there
+   */
+  bool skip_arrow(std::string_view str, size_t& i) noexcept {
+    while (i < str.size() && is_space(str[i]))
+      ++i;
+    auto const dashes = i;
+    while (i < str.size() && str[i] == '-')
+      ++i;
+    if (i == dashes || i >= str.size() || str[i++] != '>')
+      return false;
+    while (i < str.size() && is_space(str[i]))
+      ++i;
+    return true;
+  }
+
+  /**
+   * @brief the loose form of a subrip timestamp: "H+:M+:S+,?m+"
+   * Without the comma, the last digit of the seconds belongs to the
+   * milliseconds (that's how the greedy regex we used to have behaved).
+   */
+  bool parse_loose_timestamp(std::string_view str,
+                             size_t& i,
+                             uint64_t& ms) noexcept {
+    uint64_t hour, min, sec, rest;
+    if (!read_number(str, i, hour) || i >= str.size() || str[i++] != ':' ||
+        !read_number(str, i, min) || i >= str.size() || str[i++] != ':')
+      return false;
+    auto const sec_begin = i;
+    if (!read_number(str, i, sec))
+      return false;
+    if (i < str.size() && str[i] == ',') {
+      if (!read_number(str, ++i, rest))
+        return false;
+    } else {
+      if (i - sec_begin < 2)
+        return false;
+      rest = static_cast<uint64_t>(str[i - 1] - '0');
+      sec /= 10;
+    }
+    ms = ((hour * 60 + min) * 60 + sec) * 1000 + rest;
+    return true;
+  }
+
+  /**
+   * @brief the slow path: "timestamp \s* -+> \s* timestamp" anywhere in the
+   * line. Only the beginning of each run of digits is tried, because starting
+   * from the middle of a run can't change the outcome.
+   */
+  std::optional<subman::duration>
+  parse_loose_duration(std::string_view str) noexcept {
+    for (size_t start = 0; start < str.size(); ++start) {
+      if (!is_digit(str[start]) || (start != 0 && is_digit(str[start - 1])))
+        continue;
+      auto i = start;
+      uint64_t from, to;
+      if (!parse_loose_timestamp(str, i, from) || !skip_arrow(str, i))
+        continue;
+      if (parse_loose_timestamp(str, i, to))
+        return subman::duration{from, to};
+    }
+    return std::nullopt;
+  }
+
+  /**
+   * @brief a webvtt timestamp: "[H+:]MM:SS.mmm"; fewer digits of the fraction
+   * are taken as a decimal fraction
+   */
+  bool parse_webvtt_timestamp(std::string_view str,
+                              size_t& i,
+                              uint64_t& ms) noexcept {
+    uint64_t parts[3], fraction = 0;
+    size_t count = 0;
+    for (;;) {
+      if (!read_number(str, i, parts[count++]))
+        return false;
+      if (count == 3 || i >= str.size() || str[i] != ':')
+        break;
+      ++i;
+    }
+    if (count < 2 || i >= str.size() || str[i++] != '.')
+      return false;
+    auto const fraction_begin = i;
+    for (; i < str.size() && is_digit(str[i]) && i - fraction_begin < 3; ++i)
+      fraction = fraction * 10 + static_cast<uint64_t>(str[i] - '0');
+    if (i == fraction_begin)
+      return false;
+    for (auto digits = i - fraction_begin; digits < 3; ++digits)
+      fraction *= 10;
+    auto const hour = count == 3 ? parts[0] : 0;
+    auto const min = parts[count - 2], sec = parts[count - 1];
+    ms = ((hour * 60 + min) * 60 + sec) * 1000 + fraction;
+    return true;
+  }
+
+} // namespace
+
+std::optional<subman::duration>
+subman::formats::to_duration(std::string_view str) noexcept {
+  if (auto const dur = parse_fixed_duration(str, ','))
+    return dur;
+  return parse_loose_duration(str);
+}
+
+std::optional<cue_timing>
+subman::formats::to_webvtt_timing(std::string_view str) noexcept {
+  constexpr size_t fixed_size = 29;
+  if (auto const dur = parse_fixed_duration(str, '.');
+      dur && (str.size() == fixed_size || is_space(str[fixed_size])))
+    return cue_timing{*dur, trim(str.substr(fixed_size))};
+
+  size_t i = 0;
+  uint64_t from, to;
+  if (!parse_webvtt_timestamp(str, i, from) || !skip_arrow(str, i) ||
+      !parse_webvtt_timestamp(str, i, to))
+    return std::nullopt;
+  if (i < str.size() && !is_space(str[i]))
+    return std::nullopt;
+  return cue_timing{subman::duration{from, to}, trim(str.substr(i))};
+}
+
+namespace {
+
+  // "00" to "99"
+  constexpr auto two_digits = [] {
+    std::array<char, 200> digits{};
+    for (size_t i = 0; i < 100; ++i) {
+      digits[i * 2] = static_cast<char>('0' + i / 10);
+      digits[i * 2 + 1] = static_cast<char>('0' + i % 10);
+    }
+    return digits;
+  }();
+
+  inline char* write_two_digits(char* out, uint64_t value) noexcept {
+    std::memcpy(out, two_digits.data() + value * 2, 2);
+    return out + 2;
+  }
+
+  /**
+   * @brief writes "HH:MM:SS,mmm"
+   */
+  char* write_timestamp(char* out, uint64_t ms, char separator) noexcept {
+    auto const hour = ms / 3'600'000;
+    ms -= hour * 3'600'000;
+    auto const min = ms / 60'000;
+    ms -= min * 60'000;
+    auto const sec = ms / 1000;
+    ms -= sec * 1000;
+
+    if (hour < 100)
+      out = write_two_digits(out, hour);
+    else
+      out = std::to_chars(out, out + 20, hour).ptr;
+    *out++ = ':';
+    out = write_two_digits(out, min);
+    *out++ = ':';
+    out = write_two_digits(out, sec);
+    *out++ = separator;
+    *out++ = static_cast<char>('0' + ms / 100);
+    return write_two_digits(out, ms % 100);
+  }
+
+} // namespace
+
+char* subman::formats::write_timing(char* out,
+                                    subman::duration const& timestamps,
+                                    char separator) noexcept {
+  out = write_timestamp(out, timestamps.from, separator);
+  std::memcpy(out, " --> ", 5);
+  return write_timestamp(out + 5, timestamps.to, separator);
+}
+
+std::string subman::formats::to_string(subman::duration const& timestamps,
+                                       char separator) noexcept {
+  char buffer[max_timing_size];
+  return {buffer, write_timing(buffer, timestamps, separator)};
+}
+
+void subman::formats::append_number(std::string& out, uint64_t number) {
+  char buffer[20];
+  out.append(buffer, std::to_chars(buffer, buffer + 20, number).ptr);
+}
+
+void subman::formats::append_timing(std::string& out,
+                                    subman::duration const& timestamps,
+                                    char separator) {
+  char buffer[max_timing_size];
+  out.append(buffer, write_timing(buffer, timestamps, separator));
+}
+
+namespace {
+
+  struct named_color {
+    std::string_view name;
+    subman::formats::rgb_color rgb;
+  };
+
+  constexpr named_color html_colors[] = {{"white", {255, 255, 255}},
+                                         {"silver", {192, 192, 192}},
+                                         {"gray", {128, 128, 128}},
+                                         {"black", {0, 0, 0}},
+                                         {"red", {255, 0, 0}},
+                                         {"maroon", {128, 0, 0}},
+                                         {"yellow", {255, 255, 0}},
+                                         {"olive", {128, 128, 0}},
+                                         {"lime", {0, 255, 0}},
+                                         {"green", {0, 128, 0}},
+                                         {"cyan", {0, 255, 255}},
+                                         {"aqua", {0, 255, 255}},
+                                         {"teal", {0, 128, 128}},
+                                         {"blue", {0, 0, 255}},
+                                         {"navy", {0, 0, 128}},
+                                         {"magenta", {255, 0, 255}},
+                                         {"fuchsia", {255, 0, 255}},
+                                         {"purple", {128, 0, 128}}};
+
+  int hex_digit(char c) noexcept {
+    if (c >= '0' && c <= '9')
+      return c - '0';
+    c = static_cast<char>(c | 0x20);
+    if (c >= 'a' && c <= 'f')
+      return c - 'a' + 10;
+    return -1;
+  }
+
+} // namespace
+
+std::optional<subman::formats::rgb_color>
+subman::formats::to_rgb(std::string_view color) noexcept {
+  color = trim(color);
+  for (auto const& c : html_colors)
+    if (iequals(color, c.name))
+      return c.rgb;
+  if (!color.starts_with('#') || (color.size() != 4 && color.size() != 7))
+    return std::nullopt;
+
+  auto const wide = color.size() == 7;
+  int rgb[3];
+  for (size_t i = 0; i < 3; ++i) {
+    auto const high = hex_digit(color[1 + i * (wide ? 2 : 1)]);
+    auto const low = hex_digit(color[wide ? 2 + i * 2 : 1 + i]);
+    if (high < 0 || low < 0)
+      return std::nullopt;
+    rgb[i] = high * 16 + low;
+  }
+  return rgb_color{rgb[0], rgb[1], rgb[2]};
+}
+
+std::string subman::formats::to_html_color(rgb_color const& color) {
+  constexpr char digits[] = "0123456789abcdef";
+  std::string html = "#";
+  for (auto const channel : {color.red, color.green, color.blue}) {
+    html += digits[channel >> 4];
+    html += digits[channel & 0xF];
+  }
+  return html;
+}
+
+subman::formats::rgb_color subman::formats::from_bgr(uint64_t bgr) noexcept {
+  return {static_cast<int>(bgr & 0xFF),
+          static_cast<int>((bgr >> 8) & 0xFF),
+          static_cast<int>((bgr >> 16) & 0xFF)};
+}
+
+void subman::formats::append_bgr(std::string& out, rgb_color const& color) {
+  constexpr char digits[] = "0123456789ABCDEF";
+  for (auto const channel : {color.blue, color.green, color.red}) {
+    out += digits[channel >> 4];
+    out += digits[channel & 0xF];
+  }
+}
+
+size_t subman::formats::number_size(uint64_t number) noexcept {
+  size_t digits = 1;
+  for (; number >= 10; number /= 10)
+    ++digits;
+  return digits;
+}
+
+size_t subman::formats::timing_size(
+    subman::duration const& timestamps) noexcept {
+  char buffer[max_timing_size];
+  return static_cast<size_t>(write_timing(buffer, timestamps) - buffer);
+}
+
+namespace {
+
+  /**
+   * @brief reads the "name=value" pairs of a tag, one at a time
+   * Values may be single-quoted, double-quoted or bare words.
+   * @return false when there's no more attributes
+   */
+  bool next_tag_attribute(std::string_view data,
+                          size_t& i,
+                          std::string_view& name,
+                          std::string_view& value) noexcept {
+    while (i < data.size()) {
+      if (!is_name_char(data[i])) {
+        ++i;
+        continue;
+      }
+      auto const name_begin = i;
+      while (i < data.size() && is_name_char(data[i]))
+        ++i;
+      name = data.substr(name_begin, i - name_begin);
+      value = {};
+      while (i < data.size() && is_space(data[i]))
+        ++i;
+      if (i >= data.size() || data[i] != '=')
+        return true; // an attribute without a value
+      ++i;
+      while (i < data.size() && is_space(data[i]))
+        ++i;
+      if (i >= data.size())
+        return true;
+      if (auto const quote = data[i]; quote == '"' || quote == '\'') {
+        auto const value_begin = ++i;
+        while (i < data.size() && data[i] != quote)
+          ++i;
+        value = data.substr(value_begin, i - value_begin);
+        if (i < data.size())
+          ++i; // the closing quote
+      } else {
+        auto const value_begin = i;
+        while (i < data.size() && !is_space(data[i]))
+          ++i;
+        value = data.substr(value_begin, i - value_begin);
+      }
+      return true;
+    }
+    return false;
+  }
+
+  // the colors that webvtt has classes for
+  constexpr std::string_view webvtt_colors[] = {
+      "white", "lime", "cyan", "red", "yellow", "magenta", "blue", "black"};
+
+  bool is_webvtt_color(std::string_view name) noexcept {
+    for (auto const color : webvtt_colors)
+      if (color == name)
+        return true;
+    return false;
+  }
+
+  void append_utf8(std::pmr::string& out, uint32_t code_point) {
+    if (code_point < 0x80) {
+      out += static_cast<char>(code_point);
+    } else if (code_point < 0x800) {
+      out += static_cast<char>(0xC0 | (code_point >> 6));
+      out += static_cast<char>(0x80 | (code_point & 0x3F));
+    } else if (code_point < 0x10000) {
+      out += static_cast<char>(0xE0 | (code_point >> 12));
+      out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+      out += static_cast<char>(0x80 | (code_point & 0x3F));
+    } else {
+      out += static_cast<char>(0xF0 | (code_point >> 18));
+      out += static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+      out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+      out += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+  }
+
+  /**
+   * @brief appends the text while replacing the webvtt character references
+   * ("&amp;", "&#x2014;", ...); the unknown ones are kept as they are
+   */
+  void append_decoded(std::pmr::string& content, std::string_view text) {
+    struct reference {
+      std::string_view name, value;
+    };
+    static constexpr reference references[] = {{"amp", "&"},
+                                               {"lt", "<"},
+                                               {"gt", ">"},
+                                               {"quot", "\""},
+                                               {"apos", "'"},
+                                               {"nbsp", "\xC2\xA0"},
+                                               {"lrm", "\xE2\x80\x8E"},
+                                               {"rlm", "\xE2\x80\x8F"}};
+    for (;;) {
+      auto const amp = text.find('&');
+      content.append(text.substr(0, amp));
+      if (amp == std::string_view::npos)
+        return;
+      text.remove_prefix(amp);
+      auto const semicolon = text.find(';');
+      auto const name = text.substr(1, semicolon - 1);
+      bool decoded = false;
+      if (semicolon != std::string_view::npos && name.size() >= 2 &&
+          name[0] == '#') {
+        auto const hex = name[1] == 'x' || name[1] == 'X';
+        uint32_t code_point = 0;
+        auto const digits = name.substr(hex ? 2 : 1);
+        decoded = !digits.empty() && digits.size() <= 6;
+        for (auto const c : digits) {
+          auto const lower = static_cast<char>(c | 0x20);
+          if (is_digit(c))
+            code_point = code_point * (hex ? 16 : 10) + (c - '0');
+          else if (hex && lower >= 'a' && lower <= 'f')
+            code_point = code_point * 16 + (lower - 'a' + 10);
+          else
+            decoded = false;
+        }
+        if (code_point > 0x10FFFF ||
+            (code_point >= 0xD800 && code_point <= 0xDFFF))
+          decoded = false;
+        if (decoded)
+          append_utf8(content, code_point);
+      } else if (semicolon != std::string_view::npos) {
+        for (auto const& ref : references) {
+          if (ref.name == name) {
+            content.append(ref.value);
+            decoded = true;
+            break;
+          }
+        }
+      }
+      if (decoded) {
+        text.remove_prefix(semicolon + 1);
+      } else {
+        content.push_back('&');
+        text.remove_prefix(1);
+      }
+    }
+  }
+
+  inline void trim_back(std::pmr::string& content, size_t floor) noexcept {
+    while (content.size() > floor && is_space(content.back()))
+      content.pop_back();
+  }
+
+  /**
+   * @brief appends a piece of the cue text to the content
+   * The whitespace around each line break is trimmed just like the lines of
+   * the cue would have been trimmed one by one, so the cue can be lexed
+   * straight out of the file's buffer.
+   * @param floor where trimming the trailing whitespace should stop (the last
+   * tag or line break)
+   * @param line_start are we still in the leading whitespace of a line
+   */
+  void append_text(std::pmr::string& content,
+                   std::string_view text,
+                   markup dialect,
+                   size_t& floor,
+                   bool& line_start) {
+    for (;;) {
+      auto const line_break = text.find('\n');
+      auto piece = text.substr(0, line_break);
+      if (line_start) {
+        while (!piece.empty() && is_space(piece.front()))
+          piece.remove_prefix(1);
+        line_start = piece.empty();
+      }
+      if (dialect == markup::webvtt)
+        append_decoded(content, piece);
+      else
+        content.append(piece);
+      if (line_break == std::string_view::npos)
+        return;
+      trim_back(content, floor);
+      content.push_back('\n');
+      floor = content.size();
+      line_start = true;
+      text.remove_prefix(line_break + 1);
+    }
+  }
+
+  /**
+   * @brief the kind of the attributes that a closing tag closes
+   */
+  std::optional<attr_kind> kind_of_tag(std::string_view tag_name) noexcept {
+    if (iequals(tag_name, "v"))
+      return attr_kind::voice;
+    for (size_t i = 0; i < subman::attr_kinds; ++i) {
+      auto const kind = static_cast<attr_kind>(i);
+      if (iequals(tag_name, subman::name_of(kind)))
+        return kind;
+    }
+    return std::nullopt;
+  }
+
+} // namespace
+
+styledstring
+subman::formats::transpile_tags(std::string_view line,
+                                markup dialect,
+                                styledstring::allocator_type const& alloc) {
+  styledstring sstr{alloc};
+  auto& content = sstr.get_content();
+  auto& attrs = sstr.get_attrs();
+  content.reserve(line.size());
+
+  // the finish of the attributes that are still open
+  auto const open = line.size();
+  size_t i = 0, text_begin = 0, floor = 0;
+  bool line_start = true;
+  while (i < line.size()) {
+    auto const lt = line.find('<', i);
+    if (lt == std::string_view::npos)
+      break;
+    auto const gt = line.find('>', lt + 1);
+    if (gt == std::string_view::npos)
+      break;
+
+    auto const data = line.substr(lt + 1, gt - lt - 1);
+    auto const closing = !data.empty() && data[0] == '/';
+    auto const name_begin = closing ? size_t{1} : size_t{0};
+    auto name_end = name_begin;
+    while (name_end < data.size() && is_name_char(data[name_end]))
+      ++name_end;
+    auto const timestamp_tag = dialect == markup::webvtt &&
+                               name_end == name_begin && !closing &&
+                               !data.empty() && is_digit(data[0]);
+    if (name_end == name_begin && !timestamp_tag) {
+      // it's not a tag (e.g. "a < b > c"), so the "<" is just text
+      i = lt + 1;
+      continue;
+    }
+    auto const tag_name = data.substr(name_begin, name_end - name_begin);
+
+    append_text(content,
+                line.substr(text_begin, lt - text_begin),
+                dialect,
+                floor,
+                line_start);
+    auto const position = floor = content.size();
+    line_start = false;
+    i = text_begin = gt + 1;
+
+    if (closing) {
+      auto const is_font = iequals(tag_name, "font");
+      if (is_font || (dialect == markup::webvtt && iequals(tag_name, "c"))) {
+        // closing the attributes of the innermost open font (or class) tag
+        auto const is_open_group = [&](subman::attr const& a) {
+          return a.pos.finish == open &&
+                 (a.kind == attr_kind::color ||
+                  a.kind ==
+                      (is_font ? attr_kind::fontsize : attr_kind::css_class));
+        };
+        std::optional<size_t> innermost;
+        for (auto const& a : attrs)
+          if (is_open_group(a) && (!innermost || a.pos.start > *innermost))
+            innermost = a.pos.start;
+        for (auto& a : attrs)
+          if (is_open_group(a) && a.pos.start == innermost)
+            a.pos.finish = position;
+        continue;
+      }
+      auto const kind = kind_of_tag(tag_name);
+      for (auto& a : attrs) {
+        if (a.pos.finish == open && a.kind == kind)
+          a.pos.finish = position;
+      }
+      continue;
+    }
+
+    subman::range pos{position, open};
+    if (iequals(tag_name, "i"))
+      sstr.italic(pos);
+    else if (iequals(tag_name, "b"))
+      sstr.bold(pos);
+    else if (iequals(tag_name, "u"))
+      sstr.underline(pos);
+    else if (iequals(tag_name, "font")) {
+      auto const attrs_data = data.substr(name_end);
+      std::string_view attr_name, value;
+      for (size_t j = 0;
+           next_tag_attribute(attrs_data, j, attr_name, value);) {
+        if (iequals(attr_name, "size"))
+          sstr.fontsize(pos, std::string{value});
+        else if (iequals(attr_name, "color"))
+          sstr.color(pos, std::string{value});
+      }
+    } else if (dialect == markup::webvtt && !timestamp_tag) {
+      // "<c.yellow.big>", "<v.loud Bob>", "<lang en>"
+      auto j = name_end;
+      while (j < data.size() && data[j] == '.') {
+        auto const class_begin = ++j;
+        while (j < data.size() && data[j] != '.' && !is_space(data[j]))
+          ++j;
+        auto const class_name = data.substr(class_begin, j - class_begin);
+        if (!iequals(tag_name, "c") || class_name.empty())
+          continue;
+        if (is_webvtt_color(class_name))
+          sstr.color(pos, std::string{class_name});
+        else
+          sstr.put_attribute(
+              subman::attr{pos, attr_kind::css_class, class_name});
+      }
+      auto const annotation = trim(data.substr(j));
+      if (iequals(tag_name, "v") || iequals(tag_name, "lang"))
+        sstr.put_attribute(subman::attr{
+            pos,
+            iequals(tag_name, "v") ? attr_kind::voice : attr_kind::lang,
+            annotation});
+    }
+    // the other tags (and the timestamp tags) are just dropped
+  }
+
+  // last pieces of the subtitle
+  append_text(content, line.substr(text_begin), dialect, floor, line_start);
+  trim_back(content, floor);
+
+  // the tags that are not closed will end with the content
+  for (auto& a : attrs) {
+    if (a.pos.finish == open)
+      a.pos.finish = content.size();
+  }
+  return sstr;
+}
+
+bool subman::formats::html_tags(std::string& out,
+                                subman::attr const& attribute,
+                                bool closing) {
+  switch (attribute.kind) {
+  case attr_kind::bold:
+  case attr_kind::italic:
+  case attr_kind::underline:
+    out += closing ? "</" : "<";
+    out += attribute.name();
+    out += '>';
+    break;
+  case attr_kind::color:
+  case attr_kind::fontsize:
+    if (closing) {
+      out += "</font>";
+    } else {
+      out += attribute.kind == attr_kind::color ? "<font color=\""
+                                                : "<font size=\"";
+      out += attribute.value;
+      out += "\">";
+    }
+    break;
+  default:
+    return false;
+  }
+  return true;
+}
+
+namespace {
+
+  // an attribute that is going to be painted, with its spelled tags
+  struct paint_span {
+    size_t start, finish;
+    size_t order;           // the position of the attribute in the list
+    size_t tags, open_size; // the tags in the scratch; the close follows
+    size_t close_size;
+  };
+
+  // counts what would have been appended to a string
+  struct size_counter {
+    size_t size = 0;
+
+    void append(std::string_view str,
+                size_t pos,
+                size_t count = std::string_view::npos) noexcept {
+      size += std::min(count, str.size() - pos);
+    }
+  };
+
+  /**
+   * @brief appends the text with "&", "<" and ">" as entities
+   */
+  template <typename Out>
+  void append_escaped(Out& out, std::string_view text) {
+    for (;;) {
+      auto const special = text.find_first_of("&<>");
+      out.append(text, 0, special);
+      if (special == std::string_view::npos)
+        return;
+      std::string_view const entity = text[special] == '&'   ? "&amp;"
+                                      : text[special] == '<' ? "&lt;"
+                                                             : "&gt;";
+      out.append(entity, 0);
+      text.remove_prefix(special + 1);
+    }
+  }
+
+  /**
+   * @brief the sweep itself; "Out" is a string or a size_counter
+   */
+  template <typename Out>
+  void paint(Out& out,
+             subman::styledstring const& sstr,
+             subman::formats::tag_speller spell,
+             subman::formats::text_escaping escaping) {
+    auto const& content = sstr.cget_content();
+    auto const& attrs = sstr.cget_attrs();
+    auto const text = [&](size_t pos, size_t count = std::string_view::npos) {
+      if (escaping == subman::formats::text_escaping::html)
+        append_escaped(out, std::string_view{content}.substr(pos, count));
+      else
+        out.append(content, pos, count);
+    };
+    if (attrs.empty()) {
+      text(0);
+      return;
+    }
+
+    // reused between the calls, so painting doesn't allocate in the long run
+    thread_local std::vector<paint_span> spans;
+    thread_local std::vector<size_t> stack, closes;
+    thread_local std::string tags;
+    spans.clear();
+    stack.clear();
+    closes.clear();
+    tags.clear();
+
+    size_t order = 0;
+    for (auto const& a : attrs) {
+      auto const finish = std::min(a.pos.finish, content.size());
+      auto const tags_begin = tags.size();
+      if (a.pos.start < finish && spell(tags, a, false)) {
+        auto const open_end = tags.size();
+        spell(tags, a, true);
+        spans.push_back({a.pos.start,
+                         finish,
+                         order,
+                         tags_begin,
+                         open_end - tags_begin,
+                         tags.size() - open_end});
+      }
+      ++order;
+    }
+
+    // the outer ones first: the longer ones, then the later ones (the styles
+    // that were put on top of the others)
+    std::sort(spans.begin(), spans.end(), [](auto const& a, auto const& b) {
+      if (a.start != b.start)
+        return a.start < b.start;
+      if (a.finish != b.finish)
+        return a.finish > b.finish;
+      return a.order > b.order;
+    });
+
+    auto const open_tag = [&](paint_span const& span) {
+      out.append(tags, span.tags, span.open_size);
+    };
+    auto const close_tag = [&](paint_span const& span) {
+      out.append(tags, span.tags + span.open_size, span.close_size);
+    };
+    auto const later = std::greater<>{};
+
+    size_t pos = 0, next = 0;
+    for (;;) {
+      auto boundary = content.size();
+      if (next < spans.size())
+        boundary = std::min(boundary, spans[next].start);
+      if (!closes.empty())
+        boundary = std::min(boundary, closes.front());
+      text(pos, boundary - pos);
+      pos = boundary;
+      if (next == spans.size() && closes.empty())
+        break;
+
+      if (!closes.empty() && closes.front() == pos) {
+        while (!closes.empty() && closes.front() == pos) {
+          std::pop_heap(closes.begin(), closes.end(), later);
+          closes.pop_back();
+        }
+        // closing everything down to the outermost one that ends here, then
+        // reopening the ones that go on (the ones that end sooner inside)
+        auto lowest = stack.size();
+        for (size_t i = 0; i < stack.size(); ++i) {
+          if (spans[stack[i]].finish == pos) {
+            lowest = i;
+            break;
+          }
+        }
+        for (auto i = stack.size(); i-- > lowest;)
+          close_tag(spans[stack[i]]);
+        auto const kept = std::remove_if(
+            stack.begin() + static_cast<std::ptrdiff_t>(lowest),
+            stack.end(),
+            [&](size_t i) { return spans[i].finish == pos; });
+        stack.erase(kept, stack.end());
+        std::stable_sort(stack.begin() + static_cast<std::ptrdiff_t>(lowest),
+                         stack.end(),
+                         [&](size_t a, size_t b) {
+                           return spans[a].finish > spans[b].finish;
+                         });
+        for (auto i = lowest; i < stack.size(); ++i)
+          open_tag(spans[stack[i]]);
+      }
+
+      for (; next < spans.size() && spans[next].start == pos; ++next) {
+        open_tag(spans[next]);
+        stack.push_back(next);
+        closes.push_back(spans[next].finish);
+        std::push_heap(closes.begin(), closes.end(), later);
+      }
+    }
+    text(pos);
+  }
+
+} // namespace
+
+void subman::formats::append_styled(std::string& out,
+                                    styledstring const& sstr,
+                                    tag_speller spell,
+                                    text_escaping escaping) {
+  paint(out, sstr, spell, escaping);
+}
+
+size_t subman::formats::styled_size(styledstring const& sstr,
+                                    tag_speller spell,
+                                    text_escaping escaping) {
+  size_counter counter;
+  paint(counter, sstr, spell, escaping);
+  return counter.size;
+}
+
+std::string subman::formats::paint_style(styledstring const& sstr,
+                                         tag_speller spell) {
+  std::string out;
+  append_styled(out, sstr, spell);
+  return out;
+}
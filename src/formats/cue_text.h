@@ -0,0 +1,165 @@
+#ifndef FORMAT_CUE_TEXT_H
+#define FORMAT_CUE_TEXT_H
+
+#include "../duration.h"
+#include "../styledstring.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+/**
+ * The lexing that the text-based formats (subrip and webvtt) share: the
+ * timestamps, the tags in the cue text and painting the attributes back as
+ * tags.
+ */
+namespace subman::formats {
+
+  inline bool is_digit(char c) noexcept {
+    return c >= '0' && c <= '9';
+  }
+
+  inline bool is_space(char c) noexcept {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f' ||
+           c == '\v';
+  }
+
+  inline bool is_name_char(char c) noexcept {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' ||
+           c == '-';
+  }
+
+  /**
+   * @brief ASCII case-insensitive comparison; "lowercase" should already be
+   * in lower case
+   */
+  bool iequals(std::string_view str, std::string_view lowercase) noexcept;
+
+  std::string_view trim(std::string_view str) noexcept;
+
+  /**
+   * @brief the timing line of a cue
+   */
+  struct cue_timing {
+    subman::duration timestamps;
+    std::string_view settings; // what comes after the end time (webvtt)
+  };
+
+  /**
+   * @brief parses a subrip timing line: "HH:MM:SS,mmm --> HH:MM:SS,mmm"
+   * The usual shape is decoded with SWAR; the loose forms ("H:M:S,m", no
+   * comma, extra text around it) go through a slower scan.
+   */
+  std::optional<subman::duration> to_duration(std::string_view str) noexcept;
+
+  /**
+   * @brief parses a webvtt timing line: "[HH:]MM:SS.mmm --> [HH:]MM:SS.mmm"
+   * followed by the cue settings
+   */
+  std::optional<cue_timing> to_webvtt_timing(std::string_view str) noexcept;
+
+  // the longest timing line (the hours may have up to 17 digits)
+  constexpr size_t max_timing_size = 64;
+
+  /**
+   * @brief writes "HH:MM:SS,mmm --> HH:MM:SS,mmm" with the given separator
+   * before the milliseconds
+   * @param out room for at least max_timing_size characters
+   * @return the end of the written text
+   */
+  char* write_timing(char* out,
+                     subman::duration const& timestamps,
+                     char separator = ',') noexcept;
+
+  std::string to_string(subman::duration const& timestamps,
+                        char separator = ',') noexcept;
+
+  // the cue writers fill a buffer and hand it to the stream in blocks
+  constexpr size_t write_block_size = 64 * 1024;
+
+  void append_number(std::string& out, uint64_t number);
+  void append_timing(std::string& out,
+                     subman::duration const& timestamps,
+                     char separator = ',');
+
+  // the sizes of what the above append, without writing anything
+  size_t number_size(uint64_t number) noexcept;
+  size_t timing_size(subman::duration const& timestamps) noexcept;
+
+  struct rgb_color {
+    int red, green, blue;
+  };
+
+  /**
+   * @brief the color of "#rgb", "#rrggbb" or one of the basic HTML color
+   * names
+   */
+  std::optional<rgb_color> to_rgb(std::string_view color) noexcept;
+
+  // "#rrggbb"
+  std::string to_html_color(rgb_color const& color);
+
+  // the colors of SubStation and MicroDVD are 0xBBGGRR numbers
+  rgb_color from_bgr(uint64_t bgr) noexcept;
+  void append_bgr(std::string& out, rgb_color const& color); // "BBGGRR"
+
+  enum class markup {
+    html,  // subrip: <i>, <b>, <u> and <font color size>
+    webvtt // the above plus <c.class>, <v voice>, <lang>, timestamp tags
+           // and the character references
+  };
+
+  /**
+   * @brief converts the tags of a cue's text into styledstring attrs
+   * The whitespace around the line breaks is trimmed, so the text can be the
+   * untrimmed lines of the cue. The styledstring is made with "alloc".
+   */
+  subman::styledstring
+  transpile_tags(std::string_view text,
+                 markup dialect,
+                 subman::styledstring::allocator_type const& alloc = {});
+
+  /**
+   * @brief appends the opening (or the closing) tag of an attribute
+   * @return false, and appends nothing, if the format can't show it
+   */
+  using tag_speller = bool (*)(std::string& out,
+                               subman::attr const& attribute,
+                               bool closing);
+
+  bool html_tags(std::string& out, subman::attr const& attribute, bool closing);
+
+  /**
+   * @brief how the text between the tags is written
+   */
+  enum class text_escaping {
+    none, // as it is
+    html  // "&", "<" and ">" as "&amp;", "&lt;" and "&gt;"
+  };
+
+  /**
+   * @brief appends the content with its attributes painted as tags
+   * It's a single sweep over the sorted attributes, so it's O(n log n) in the
+   * number of them. The tags are always properly nested: the longer
+   * attributes are the outer ones, and the inner ones are closed and
+   * reopened around the end of an outer attribute that overlaps them.
+   * Empty attributes and the ones the format can't show are skipped.
+   */
+  void append_styled(std::string& out,
+                     styledstring const& sstr,
+                     tag_speller spell = html_tags,
+                     text_escaping escaping = text_escaping::none);
+
+  /**
+   * @brief the size of what append_styled would append
+   */
+  size_t styled_size(styledstring const& sstr,
+                     tag_speller spell = html_tags,
+                     text_escaping escaping = text_escaping::none);
+
+  std::string paint_style(styledstring const& sstr,
+                          tag_speller spell = html_tags);
+
+} // namespace subman::formats
+
+#endif // FORMAT_CUE_TEXT_H
@@ -0,0 +1,169 @@
+#ifndef FORMAT_CUE_WRITER_H
+#define FORMAT_CUE_WRITER_H
+
+#include "../document.h"
+#include "../mapped_file.h"
+#include "cue_text.h"
+#include <algorithm>
+#include <cstdint>
+#include <future>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * The writing machinery of the line-based formats (subrip and webvtt). A
+ * format tells how its cues are spelled, through a "Serializer":
+ *
+ *   static constexpr std::string_view header;
+ *   static void append_cue(std::string& out, uint64_t index,
+ *                          subtitle const& cue);
+ *   static size_t cue_size(uint64_t index, subtitle const& cue);
+ *
+ * where "cue_size" is exactly the number of bytes that "append_cue" appends.
+ */
+namespace subman::formats {
+
+  /**
+   * @brief spells the cues (any range of subtitles, like a generator) and
+   * gives them to "write" in blocks of write_block_size
+   */
+  template <typename Serializer, typename Cues, typename Write>
+  void write_blocks(Cues&& cues, Write&& write) {
+    std::string buffer{Serializer::header};
+    buffer.reserve(write_block_size * 2);
+    uint64_t index = 1;
+    for (auto const& cue : cues) {
+      Serializer::append_cue(buffer, index++, cue);
+      if (buffer.size() >= write_block_size) {
+        write(std::string_view{buffer});
+        buffer.clear();
+      }
+    }
+    write(std::string_view{buffer});
+  }
+
+  /**
+   * @brief writes the cues (any range of subtitles, like a generator) into
+   * the stream
+   */
+  template <typename Serializer, typename Cues>
+  void write_cues(Cues&& cues, std::ostream& out) {
+    if (!out) {
+      throw std::invalid_argument("Cannot write data into stream");
+    }
+    write_blocks<Serializer>(std::forward<Cues>(cues),
+                             [&out](std::string_view block) {
+                               out.write(
+                                   block.data(),
+                                   static_cast<std::streamsize>(block.size()));
+                             });
+  }
+
+  template <typename Serializer>
+  void write_cues(subman::document const& doc, std::ostream& out) {
+    write_cues<Serializer>(doc.subtitles, out);
+  }
+
+  /**
+   * @brief writes the chunks of a big document into the file on all the
+   * cores, in two passes
+   * The first pass measures every chunk and gives each one its place in the
+   * file; the file is then given its final size and the second pass
+   * paints the chunks right into their places. The cues are numbered by
+   * their place in the whole document, so the bytes are identical to what
+   * the sequential writer writes.
+   */
+  template <typename Serializer>
+  void write_parallel(subman::document const& doc,
+                      subman::output_file& file,
+                      size_t chunks) {
+    using cue_iterator = typename decltype(doc.subtitles)::const_iterator;
+    auto const count = doc.subtitles.size();
+
+    // the first cue of each chunk, and its number
+    std::vector<cue_iterator> bounds;
+    std::vector<uint64_t> firsts;
+    auto cue = doc.subtitles.begin();
+    for (size_t i = 0, first = 1; i < chunks; ++i) {
+      bounds.push_back(cue);
+      firsts.push_back(first);
+      auto const size = count / chunks + (i < count % chunks ? 1 : 0);
+      std::advance(cue, static_cast<std::ptrdiff_t>(size));
+      first += size;
+    }
+    bounds.push_back(doc.subtitles.end());
+
+    std::vector<std::future<size_t>> sizing;
+    for (size_t i = 0; i < chunks; ++i) {
+      sizing.emplace_back(std::async(std::launch::async, [&, i] {
+        size_t size = 0;
+        auto index = firsts[i];
+        for (auto c = bounds[i]; c != bounds[i + 1]; ++c)
+          size += Serializer::cue_size(index++, *c);
+        return size;
+      }));
+    }
+    std::vector<size_t> offsets{Serializer::header.size()};
+    for (auto& size : sizing)
+      offsets.push_back(offsets.back() + size.get());
+
+    file.resize(offsets.back());
+    file.write_at(Serializer::header, 0);
+
+    std::vector<std::future<void>> painters;
+    for (size_t i = 0; i < chunks; ++i) {
+      painters.emplace_back(std::async(std::launch::async, [&, i] {
+        std::string buffer;
+        buffer.reserve(write_block_size * 2);
+        auto offset = offsets[i];
+        auto index = firsts[i];
+        for (auto c = bounds[i]; c != bounds[i + 1]; ++c) {
+          Serializer::append_cue(buffer, index++, *c);
+          if (buffer.size() >= write_block_size) {
+            file.write_at(buffer, offset);
+            offset += buffer.size();
+            buffer.clear();
+          }
+        }
+        if (offset + buffer.size() != offsets[i + 1])
+          throw std::logic_error("The size of a chunk was measured wrong.");
+        file.write_at(buffer, offset);
+      }));
+    }
+    for (auto& painter : painters)
+      painter.get();
+    file.close();
+  }
+
+  // documents with fewer cues are not worth the threads
+  constexpr size_t parallel_write_threshold = 16 * 1024;
+  constexpr size_t min_write_chunk = 4 * 1024;
+
+  /**
+   * @brief writes the cues into a file; the big documents are written on all
+   * the cores, when the file is a regular one
+   */
+  template <typename Serializer>
+  void write_cues(subman::document const& doc, std::string const& path) {
+    subman::output_file file{path};
+    auto const count = doc.subtitles.size();
+    if (count >= parallel_write_threshold && file.is_regular()) {
+      auto const chunks = std::min<size_t>(std::thread::hardware_concurrency(),
+                                           count / min_write_chunk);
+      if (chunks > 1)
+        return write_parallel<Serializer>(doc, file, chunks);
+    }
+    write_blocks<Serializer>(doc.subtitles, [&file](std::string_view block) {
+      file.write(block);
+    });
+    file.close();
+  }
+
+} // namespace subman::formats
+
+#endif // FORMAT_CUE_WRITER_H
@@ -0,0 +1,141 @@
+#include "export.h"
+#include <stdexcept>
+
+using namespace subman::formats;
+
+namespace {
+
+  constexpr char hex_digits[] = "0123456789abcdef";
+
+  void append_u64(std::string& out, uint64_t number) {
+    for (int i = 0; i < 8; ++i)
+      out += static_cast<char>((number >> (i * 8)) & 0xff);
+  }
+
+} // namespace
+
+void subman::formats::append_json_string(std::string& out,
+                                         std::string_view str) {
+  out += '"';
+  auto plain = str.begin();
+  for (auto it = str.begin(); it != str.end(); ++it) {
+    auto const c = static_cast<unsigned char>(*it);
+    if (c >= 0x20 && c != '"' && c != '\\')
+      continue;
+    out.append(plain, it);
+    plain = it + 1;
+    switch (c) {
+    case '"':
+      out += "\\\"";
+      break;
+    case '\\':
+      out += "\\\\";
+      break;
+    case '\n':
+      out += "\\n";
+      break;
+    case '\r':
+      out += "\\r";
+      break;
+    case '\t':
+      out += "\\t";
+      break;
+    default:
+      out += "\\u00";
+      out += hex_digits[c >> 4];
+      out += hex_digits[c & 0xf];
+    }
+  }
+  out.append(plain, str.end());
+  out += '"';
+}
+
+void subman::formats::append_ndjson(std::string& out,
+                                    subman::subtitle const& cue,
+                                    std::string_view source) {
+  out += "{\"start\":";
+  append_number(out, cue.timestamps.from);
+  out += ",\"end\":";
+  append_number(out, cue.timestamps.to);
+  out += ",\"text\":";
+  append_json_string(out, cue.content.cget_content());
+  out += ",\"attrs\":[";
+  bool first = true;
+  for (auto const& a : cue.content.cget_attrs()) {
+    if (!first)
+      out += ',';
+    first = false;
+    out += "{\"name\":";
+    append_json_string(out, a.name());
+    out += ",\"value\":";
+    append_json_string(out, a.value);
+    out += ",\"start\":";
+    append_number(out, a.pos.start);
+    out += ",\"end\":";
+    append_number(out, a.pos.finish);
+    out += '}';
+  }
+  out += "],\"source\":";
+  append_json_string(out, source);
+  out += "}\n";
+}
+
+columnar_writer::columnar_writer(std::ostream& out) : out{out} {
+  if (!out)
+    throw std::invalid_argument("Cannot write data into stream");
+  buffer.reserve(write_block_size * 2);
+  buffer += columnar_magic;
+}
+
+void columnar_writer::spill() {
+  out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+  written += buffer.size();
+  buffer.clear();
+}
+
+void columnar_writer::pad() {
+  while ((written + buffer.size()) % 8 != 0)
+    buffer += '\0';
+}
+
+void columnar_writer::append_column(std::vector<uint64_t> const& column) {
+  for (auto const number : column) {
+    append_u64(buffer, number);
+    if (buffer.size() >= write_block_size)
+      spill();
+  }
+}
+
+void columnar_writer::put(subman::subtitle const& cue) {
+  auto const& text = cue.content.cget_content();
+  starts.push_back(cue.timestamps.from);
+  ends.push_back(cue.timestamps.to);
+  offsets.push_back(offsets.back() + text.size());
+  buffer += text;
+  if (buffer.size() >= write_block_size)
+    spill();
+}
+
+void columnar_writer::close() {
+  if (closed)
+    return;
+  closed = true;
+  uint64_t const text_offset = columnar_magic.size();
+  auto const text_size = offsets.back();
+  pad();
+  auto const starts_offset = written + buffer.size();
+  auto const ends_offset = starts_offset + starts.size() * 8;
+  auto const offsets_offset = ends_offset + ends.size() * 8;
+  append_column(starts);
+  append_column(ends);
+  append_column(offsets);
+
+  append_u64(buffer, starts.size());
+  append_u64(buffer, text_offset);
+  append_u64(buffer, text_size);
+  append_u64(buffer, starts_offset);
+  append_u64(buffer, ends_offset);
+  append_u64(buffer, offsets_offset);
+  buffer += columnar_magic;
+  spill();
+}
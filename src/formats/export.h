@@ -0,0 +1,100 @@
+#ifndef FORMAT_EXPORT_H
+#define FORMAT_EXPORT_H
+
+#include "../subtitle.h"
+#include "cue_text.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * The exports for the analytics tools; they can't be read back. Both of them
+ * take any range of cues (the subtitles of a document, or the cue generator)
+ * and write them as they come.
+ */
+namespace subman::formats {
+
+  /**
+   * @brief appends the string as a quoted JSON string
+   */
+  void append_json_string(std::string& out, std::string_view str);
+
+  /**
+   * @brief appends one NDJSON record:
+   * {"start":ms,"end":ms,"text":"...","attrs":[{"name":"b","value":"",
+   * "start":0,"end":5}],"source":"a.srt"}
+   * The attribute ranges are byte offsets into the UTF-8 text.
+   */
+  void append_ndjson(std::string& out,
+                     subman::subtitle const& cue,
+                     std::string_view source);
+
+  template <typename Cues>
+  void write_ndjson(Cues&& cues, std::string_view source, std::ostream& out) {
+    std::string buffer;
+    buffer.reserve(write_block_size * 2);
+    for (auto const& cue : cues) {
+      append_ndjson(buffer, cue, source);
+      if (buffer.size() >= write_block_size) {
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        buffer.clear();
+      }
+    }
+    out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+  }
+
+  // at the start and the end of the columnar files
+  constexpr std::string_view columnar_magic = "SUBMCOL1";
+
+  /**
+   * @brief writes the cues in columns that numpy or Arrow can map directly
+   *
+   * All the numbers are little-endian uint64 and all the sections start at
+   * multiples of 8:
+   *
+   *   "SUBMCOL1"
+   *   text     the plain texts, one after another (then padded)
+   *   starts   [count] the start of each cue, in milliseconds
+   *   ends     [count] the end of each cue, in milliseconds
+   *   offsets  [count + 1] where each text starts in "text"
+   *   footer   count, text offset, text size, starts offset, ends offset,
+   *            offsets offset (from the start of the file), "SUBMCOL1"
+   *
+   * The texts are written as they come, and the columns (24 bytes a cue) are
+   * kept until close(), so the output doesn't need to be seekable.
+   */
+  class columnar_writer {
+    std::ostream& out;
+    std::string buffer;
+    std::vector<uint64_t> starts, ends, offsets{0};
+    uint64_t written = 0; // the bytes before the buffer
+    bool closed = false;
+
+    void append_column(std::vector<uint64_t> const& column);
+    void pad();
+    void spill();
+
+  public:
+    explicit columnar_writer(std::ostream& out);
+    columnar_writer(columnar_writer const&) = delete;
+    columnar_writer& operator=(columnar_writer const&) = delete;
+
+    void put(subman::subtitle const& cue);
+
+    // writes the columns and the footer
+    void close();
+  };
+
+  template <typename Cues>
+  void write_columnar(Cues&& cues, std::ostream& out) {
+    columnar_writer writer{out};
+    for (auto const& cue : cues)
+      writer.put(cue);
+    writer.close();
+  }
+
+} // namespace subman::formats
+
+#endif // FORMAT_EXPORT_H
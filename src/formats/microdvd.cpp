@@ -0,0 +1,308 @@
+#include "microdvd.h"
+#include "../encoding.h"
+#include "cue_text.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory_resource>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+using namespace subman::formats;
+using subman::attr_kind;
+using subman::styledstring;
+
+namespace {
+
+  constexpr auto npos = std::string_view::npos;
+
+  // the end of a cue that the file doesn't tell
+  constexpr auto no_frame = std::numeric_limits<uint64_t>::max();
+
+  /**
+   * @brief reads a "{frame}" off the front of the line; "{}" is no_frame
+   * @return false if it's not there
+   */
+  bool take_frame(std::string_view& line, uint64_t& frame) noexcept {
+    if (line.empty() || line[0] != '{')
+      return false;
+    auto const close = line.find('}');
+    if (close == npos)
+      return false;
+    auto const digits = line.substr(1, close - 1);
+    if (digits.empty()) {
+      frame = no_frame;
+    } else {
+      auto const [end, error] =
+          std::from_chars(digits.data(), digits.data() + digits.size(), frame);
+      if (error != std::errc{} || end != digits.data() + digits.size())
+        return false;
+    }
+    line.remove_prefix(close + 1);
+    return true;
+  }
+
+  /**
+   * @brief puts the attributes of a control code ("y:i,b", "c:$0000FF",
+   * "s:12") over the range
+   */
+  void control_code(std::string_view code,
+                    subman::range const& range,
+                    subman::attr_list& attrs) {
+    if (range.start >= range.finish)
+      return;
+    auto const value = trim(code.substr(2));
+    switch (code[0] | 0x20) {
+    case 'y':
+      for (size_t i = 0; i <= value.size();) {
+        auto const comma = std::min(value.find(',', i), value.size());
+        auto const style = trim(value.substr(i, comma - i));
+        if (iequals(style, "i"))
+          attrs.emplace_back(range, attr_kind::italic);
+        else if (iequals(style, "b"))
+          attrs.emplace_back(range, attr_kind::bold);
+        else if (iequals(style, "u"))
+          attrs.emplace_back(range, attr_kind::underline);
+        i = comma + 1;
+      }
+      break;
+    case 'c': {
+      uint64_t bgr = 0;
+      auto const hex = value.starts_with('$') ? value.substr(1) : value;
+      auto const [end, error] =
+          std::from_chars(hex.data(), hex.data() + hex.size(), bgr, 16);
+      if (!hex.empty() && error == std::errc{} &&
+          end == hex.data() + hex.size())
+        attrs.emplace_back(
+            range, attr_kind::color, to_html_color(from_bgr(bgr)));
+      break;
+    }
+    case 's':
+      if (!value.empty() && std::all_of(value.begin(), value.end(), is_digit))
+        attrs.emplace_back(range, attr_kind::fontsize, value);
+      break;
+    default:
+      // the fonts, the positions and such
+      break;
+    }
+  }
+
+  bool is_control_code(std::string_view text) noexcept {
+    return text.size() > 3 && text[0] == '{' && text[2] == ':' &&
+           is_name_char(text[1]);
+  }
+
+  styledstring lex(std::string_view text,
+                   styledstring::allocator_type const& alloc) {
+    struct line_code {
+      std::string_view code;
+      size_t start; // it goes on to the end of the line
+    };
+    std::pmr::string content{alloc};
+    subman::attr_list attrs{alloc};
+    std::vector<std::string_view> cue_codes;
+    std::vector<line_code> line_codes;
+    for (size_t i = 0; i <= text.size();) {
+      auto const bar = std::min(text.find('|', i), text.size());
+      auto line = trim(text.substr(i, bar - i));
+      if (i != 0)
+        content += '\n';
+      i = bar + 1;
+
+      auto const line_start = content.size();
+      auto const italic_line = line.starts_with('/');
+      if (italic_line)
+        line = trim(line.substr(1));
+
+      // the codes are usually at the start, but they may come anywhere; the
+      // upper-case ones are for the whole cue
+      line_codes.clear();
+      for (auto brace = line.find('{'); brace != npos;
+           brace = line.find('{')) {
+        auto const close = line.find('}', brace);
+        if (close == npos || !is_control_code(line.substr(brace)))
+          break;
+        content += line.substr(0, brace);
+        auto const code = line.substr(brace + 1, close - brace - 1);
+        if (code[0] >= 'A' && code[0] <= 'Z')
+          cue_codes.push_back(code);
+        else
+          line_codes.push_back({code, content.size()});
+        line.remove_prefix(close + 1);
+        if (content.size() == line_start)
+          line = trim(line);
+      }
+      content += line;
+      while (content.size() > line_start && is_space(content.back()))
+        content.pop_back();
+
+      for (auto const& c : line_codes)
+        control_code(c.code, {c.start, content.size()}, attrs);
+      if (italic_line)
+        control_code("y:i", {line_start, content.size()}, attrs);
+    }
+    for (auto const code : cue_codes)
+      control_code(code, {0, content.size()}, attrs);
+    return styledstring{std::move(content), std::move(attrs)};
+  }
+
+  bool covers(subman::attr const& a, subman::range const& r) noexcept {
+    return a.pos.start <= r.start && a.pos.finish >= r.finish &&
+           r.start < r.finish;
+  }
+
+  /**
+   * @brief writes the control codes of the attributes that cover the range;
+   * upper-case ones for the whole cue
+   */
+  void append_codes(std::string& out,
+                    styledstring const& sstr,
+                    subman::range const& range,
+                    bool whole) {
+    subman::range const cue{0, sstr.cget_content().size()};
+    std::string styles;
+    std::optional<rgb_color> color;
+    std::string_view fontsize;
+    for (auto const& a : sstr.cget_attrs()) {
+      if (!covers(a, range) || (!whole && covers(a, cue)))
+        continue;
+      if (a.kind == attr_kind::italic || a.kind == attr_kind::bold ||
+          a.kind == attr_kind::underline) {
+        if (styles.find(a.name()) == std::string::npos) {
+          if (!styles.empty())
+            styles += ',';
+          styles += a.name();
+        }
+      } else if (a.kind == attr_kind::color && !color) {
+        color = to_rgb(a.value);
+      } else if (a.kind == attr_kind::fontsize && fontsize.empty() &&
+                 !a.value.empty()) {
+        std::string_view const value = a.value;
+        if (std::all_of(value.begin(), value.end(), is_digit))
+          fontsize = value;
+      }
+    }
+    if (!styles.empty()) {
+      out += whole ? "{Y:" : "{y:";
+      out += styles;
+      out += '}';
+    }
+    if (color) {
+      out += whole ? "{C:$" : "{c:$";
+      append_bgr(out, *color);
+      out += '}';
+    }
+    if (!fontsize.empty()) {
+      out += whole ? "{S:" : "{s:";
+      out += fontsize;
+      out += '}';
+    }
+  }
+
+} // namespace
+
+bool microdvd::sniff(std::string_view head) noexcept {
+  auto line = trim(head.substr(0, head.find('\n')));
+  uint64_t start, end;
+  return take_frame(line, start) && start != no_frame &&
+         take_frame(line, end);
+}
+
+subman::document microdvd::read(std::istream& stream) noexcept(false) {
+  if (stream) {
+    std::string data{std::istreambuf_iterator<char>{stream}, {}};
+    subman::utf8_text text{data};
+    return read(text.view());
+  }
+  throw std::invalid_argument("Cannot read the content of the file.");
+}
+
+subman::document microdvd::read(std::string_view buffer) noexcept(false) {
+  subman::document doc;
+  auto fps = frame_rate;
+  std::vector<uint64_t> frames; // the start and the end of each cue
+  std::vector<styledstring> texts;
+  while (!buffer.empty()) {
+    auto const eol = std::min(buffer.find('\n'), buffer.size());
+    auto line = trim(buffer.substr(0, eol));
+    buffer.remove_prefix(std::min(eol + 1, buffer.size()));
+    uint64_t start, end;
+    if (!take_frame(line, start) || start == no_frame ||
+        !take_frame(line, end))
+      continue;
+
+    // "{1}{1}23.976" tells the frame rate
+    if (texts.empty() && start == end) {
+      if (auto const rate = to_framerate(line)) {
+        fps = *rate;
+        continue;
+      }
+    }
+    frames.push_back(start);
+    frames.push_back(end);
+    texts.push_back(lex(line, doc.subtitles.get_allocator()));
+  }
+
+  // the open ends go on to the next cue; the last one lasts three seconds
+  for (size_t i = 1; i < frames.size(); i += 2) {
+    if (frames[i] != no_frame)
+      continue;
+    frames[i] = i + 1 < frames.size()
+                    ? frames[i + 1]
+                    : frames[i - 1] + (3 * fps.num + fps.den / 2) / fps.den;
+  }
+  frames_to_milliseconds(frames, fps);
+
+  subman::document_builder builder{doc};
+  for (size_t i = 0; i < texts.size(); ++i) {
+    builder.put_subtitle(subman::subtitle{
+        std::move(texts[i]), {frames[i * 2], frames[i * 2 + 1]}});
+  }
+  builder.flush();
+  return doc;
+}
+
+void microdvd::write(subman::document const& sub,
+                     std::ostream& out) noexcept(false) {
+  if (!out) {
+    throw std::invalid_argument("Cannot write data into stream");
+  }
+  std::vector<uint64_t> frames;
+  frames.reserve(sub.subtitles.size() * 2);
+  for (auto const& v : sub.subtitles) {
+    frames.push_back(v.timestamps.from);
+    frames.push_back(v.timestamps.to);
+  }
+  milliseconds_to_frames(frames, frame_rate);
+
+  std::string buffer = "{1}{1}" + subman::to_string(frame_rate) + '\n';
+  buffer.reserve(write_block_size * 2);
+  auto frame = frames.begin();
+  for (auto const& v : sub.subtitles) {
+    buffer += '{';
+    append_number(buffer, *frame++);
+    buffer += "}{";
+    append_number(buffer, *frame++);
+    buffer += '}';
+
+    auto const& content = v.content.cget_content();
+    append_codes(buffer, v.content, {0, content.size()}, true);
+    for (size_t i = 0; i <= content.size();) {
+      auto const eol = std::min(content.find('\n', i), content.size());
+      if (i != 0)
+        buffer += '|';
+      append_codes(buffer, v.content, {i, eol}, false);
+      buffer.append(content, i, eol - i);
+      i = eol + 1;
+    }
+    buffer += '\n';
+    if (buffer.size() >= write_block_size) {
+      out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+      buffer.clear();
+    }
+  }
+  out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+}
@@ -0,0 +1,49 @@
+#ifndef FORMAT_MICRODVD_H
+#define FORMAT_MICRODVD_H
+
+#include "../document.h"
+#include "../duration.h"
+#include <istream>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace subman::formats {
+
+    /**
+     * @brief MicroDVD: "{start frame}{end frame}text|second line"
+     *
+     * The frames are turned into milliseconds with the frame rate that the
+     * "{1}{1}23.976" line at the top says, or with "frame_rate" when there's
+     * none. All the frames of a file are converted in one pass, after it's
+     * lexed.
+     *
+     * "{Y:i,b,u}", "{C:$BBGGRR}" and "{S:size}" style the whole cue and their
+     * lower-case forms (and a "/" at the start of a line for italic) style a
+     * line; the other control codes are dropped. The writer puts the
+     * attributes that cover whole cues or whole lines back the same way,
+     * since MicroDVD can't style a part of a line.
+     */
+    class microdvd {
+    public:
+      static constexpr std::string_view name = "microdvd";
+      static constexpr std::string_view extensions[] = {".sub"};
+
+      // the frame rate of the files that don't say it (and of the writer)
+      static inline subman::framerate frame_rate{};
+
+      microdvd() = delete;
+
+      /**
+       * @brief checks for a "{frame}{frame}" at the start
+       */
+      static bool sniff(std::string_view head) noexcept;
+      static subman::document read(std::istream& stream) noexcept(false);
+      static subman::document read(std::string_view buffer) noexcept(false);
+      static void write(subman::document const& sub,
+                        std::ostream& out) noexcept(false);
+    };
+
+} // namespace subman::formats
+
+#endif // FORMAT_MICRODVD_H
@@ -0,0 +1,78 @@
+#ifndef FORMAT_REGISTRY_H
+#define FORMAT_REGISTRY_H
+
+#include "ass.h"
+#include "microdvd.h"
+#include "subrip.h"
+#include "webvtt.h"
+#include <algorithm>
+#include <cctype>
+#include <string_view>
+
+namespace subman::formats {
+
+  /**
+   * @brief checks if "name" is the format's name or one of its extensions
+   * (with or without the dot), case-insensitively
+   */
+  template <typename Format>
+  bool is_named(std::string_view name) noexcept {
+    if (name.starts_with('.'))
+      name.remove_prefix(1);
+    auto const same = [name](std::string_view other) noexcept {
+      return std::ranges::equal(name, other, [](char a, char b) {
+        return std::tolower(static_cast<unsigned char>(a)) ==
+               std::tolower(static_cast<unsigned char>(b));
+      });
+    };
+    if (same(Format::name))
+      return true;
+    return std::ranges::any_of(Format::extensions,
+                               [&](std::string_view ext) {
+                                 return same(ext.substr(1));
+                               });
+  }
+
+  /**
+   * @brief A compile-time list of the subtitle formats
+   *
+   * Each format has a static "name", "extensions", "sniff", "read" and
+   * "write". The format is picked once per file and the call is dispatched
+   * statically to it, so there are no virtual calls in the readers or the
+   * writers. The order matters for sniffing: the first format that recognizes
+   * the content wins, so the strict formats should come before the loose
+   * ones.
+   */
+  template <typename... Formats>
+  struct format_list {
+
+    /**
+     * @brief calls "func.template operator()<Format>()" with the first format
+     * that recognizes the beginning of the (UTF-8) text
+     * @return false if none of them does
+     */
+    template <typename Func>
+    static bool with_sniffed(std::string_view head, Func&& func) {
+      return ((Formats::sniff(head) &&
+               (func.template operator()<Formats>(), true)) ||
+              ...);
+    }
+
+    /**
+     * @brief calls "func.template operator()<Format>()" with the format that
+     * has this name or extension (like "srt", ".srt" or "subrip")
+     * @return false if none of them does
+     */
+    template <typename Func>
+    static bool with_name(std::string_view name, Func&& func) {
+      return ((is_named<Formats>(name) &&
+               (func.template operator()<Formats>(), true)) ||
+              ...);
+    }
+  };
+
+  using known_formats = format_list<webvtt, ass, microdvd, subrip>;
+
+} // namespace subman::formats
+
+#endif // FORMAT_REGISTRY_H
@@ -2,18 +2,56 @@
 #define FORMAT_SUBRIP_H
 
 #include "../document.h"
-#include <regex>
+#include "../generator.h"
+#include <istream>
+#include <ostream>
 #include <string>
+#include <string_view>
 
 namespace subman::formats {
-    std::string paint_style(styledstring sstr) noexcept;
 
     class subrip {
     public:
+      static constexpr std::string_view name = "subrip";
+      static constexpr std::string_view extensions[] = {".srt"};
+
       subrip() = delete;
+
+      /**
+       * @brief checks if the text looks like subrip: a timestamp line in the
+       * first few lines
+       */
+      static bool sniff(std::string_view head) noexcept;
       static subman::document read(std::istream& stream) noexcept(false);
+
+      /**
+       * @brief reads the subtitles straight out of a buffer (usually a
+       * memory-mapped file); the cues' text is copied only once.
+       */
+      static subman::document read(std::string_view buffer) noexcept(false);
+
+      /**
+       * @brief yields the cues one by one, in the order they are in the
+       * stream; nothing but the current cue is kept in the memory.
+       * The stream should be UTF-8; each line is validated on its own.
+       */
+      static subman::generator<subman::subtitle> cues(std::istream& stream);
       static void write(subman::document const& sub,
                         std::ostream& out) noexcept(false);
+
+      /**
+       * @brief writes into a file; the big documents are written on all the
+       * cores, straight into their places in the file
+       */
+      static void write(subman::document const& sub,
+                        std::string const& path) noexcept(false);
+
+      /**
+       * @brief writes the cues as they come; only a block of the output is
+       * kept in the memory
+       */
+      static void write(subman::generator<subman::subtitle>& cues,
+                        std::ostream& out) noexcept(false);
     };
 
 } // namespace subman::formats
@@ -0,0 +1,192 @@
+#include "webvtt.h"
+#include "../encoding.h"
+#include "cue_reader.h"
+#include "cue_text.h"
+#include "cue_writer.h"
+#include <iterator>
+#include <limits>
+
+using namespace subman::formats;
+using subman::attr_kind;
+using subman::styledstring;
+
+namespace {
+
+  struct webvtt_dialect {
+    static std::optional<cue_timing> timing(std::string_view line) noexcept {
+      return to_webvtt_timing(line);
+    }
+
+    static styledstring text(std::string_view text,
+                             std::string_view settings,
+                             styledstring::allocator_type const& alloc) {
+      auto sstr = transpile_tags(text, markup::webvtt, alloc);
+      if (!settings.empty()) {
+        sstr.put_attribute(subman::attr{
+            {0, sstr.cget_content().size()}, attr_kind::settings, settings});
+      }
+      return sstr;
+    }
+  };
+
+  struct palette_color {
+    std::string_view name;
+    int red, green, blue;
+  };
+
+  // the colors that webvtt has classes for
+  constexpr palette_color palette[] = {{"white", 255, 255, 255},
+                                       {"lime", 0, 255, 0},
+                                       {"cyan", 0, 255, 255},
+                                       {"red", 255, 0, 0},
+                                       {"yellow", 255, 255, 0},
+                                       {"magenta", 255, 0, 255},
+                                       {"blue", 0, 0, 255},
+                                       {"black", 0, 0, 0}};
+
+  /**
+   * @brief the class of a color; "#rgb" and "#rrggbb" get the nearest color
+   * of the palette and the other names are used as they are
+   * @return empty if it can't be a class name
+   */
+  std::string_view color_class(std::string_view color) noexcept {
+    for (auto const& c : palette)
+      if (iequals(color, c.name))
+        return c.name;
+
+    if (color.starts_with('#')) {
+      auto const rgb = to_rgb(color);
+      if (!rgb)
+        return {};
+      auto nearest = palette[0].name;
+      auto best = std::numeric_limits<int>::max();
+      for (auto const& c : palette) {
+        auto const distance = (c.red - rgb->red) * (c.red - rgb->red) +
+                              (c.green - rgb->green) * (c.green - rgb->green) +
+                              (c.blue - rgb->blue) * (c.blue - rgb->blue);
+        if (distance < best) {
+          best = distance;
+          nearest = c.name;
+        }
+      }
+      return nearest;
+    }
+
+    for (auto const c : color)
+      if (!is_name_char(c) && !is_digit(c))
+        return {};
+    return color;
+  }
+
+  bool webvtt_tags(std::string& out,
+                   subman::attr const& attribute,
+                   bool closing) {
+    auto const kind = attribute.kind;
+    if (kind == attr_kind::bold || kind == attr_kind::underline ||
+        kind == attr_kind::italic) {
+      out += closing ? "</" : "<";
+      out += attribute.name();
+      out += '>';
+      return true;
+    }
+
+    std::string_view class_name;
+    if (kind == attr_kind::color)
+      class_name = color_class(attribute.value);
+    else if (kind == attr_kind::css_class)
+      class_name = attribute.value;
+    if (!class_name.empty()) {
+      if (closing) {
+        out += "</c>";
+      } else {
+        out += "<c.";
+        out += class_name;
+        out += '>';
+      }
+      return true;
+    }
+
+    if (kind == attr_kind::voice || kind == attr_kind::lang) {
+      auto const tag = kind == attr_kind::voice ? "v" : "lang";
+      out += closing ? "</" : "<";
+      out += tag;
+      if (!closing) {
+        out += ' ';
+        out += attribute.value;
+      }
+      out += '>';
+      return true;
+    }
+    return false;
+  }
+
+  std::string_view settings_of(subman::subtitle const& cue) noexcept {
+    for (auto const& a : cue.content.cget_attrs())
+      if (a.kind == attr_kind::settings && !a.value.empty())
+        return a.value;
+    return {};
+  }
+
+  struct webvtt_serializer {
+    static constexpr std::string_view header = "WEBVTT\n\n";
+
+    static void append_cue(std::string& out,
+                           uint64_t,
+                           subman::subtitle const& cue) {
+      append_timing(out, cue.timestamps, '.');
+      if (auto const settings = settings_of(cue); !settings.empty()) {
+        out += ' ';
+        out += settings;
+      }
+      out += '\n';
+      append_styled(out, cue.content, webvtt_tags, text_escaping::html);
+      out += "\n\n";
+    }
+
+    static size_t cue_size(uint64_t, subman::subtitle const& cue) {
+      auto size = timing_size(cue.timestamps) + 1;
+      if (auto const settings = settings_of(cue); !settings.empty())
+        size += 1 + settings.size();
+      size += styled_size(cue.content, webvtt_tags, text_escaping::html);
+      return size + 2;
+    }
+  };
+
+} // namespace
+
+bool webvtt::sniff(std::string_view head) noexcept {
+  return head.starts_with("WEBVTT") &&
+         (head.size() == 6 || is_space(head[6]));
+}
+
+subman::document webvtt::read(std::istream& stream) noexcept(false) {
+  if (stream) {
+    std::string data{std::istreambuf_iterator<char>{stream}, {}};
+    subman::utf8_text text{data};
+    return read(text.view());
+  }
+  throw std::invalid_argument("Cannot read the content of the file.");
+}
+
+subman::document webvtt::read(std::string_view buffer) noexcept(false) {
+  return read_cues<webvtt_dialect>(buffer);
+}
+
+subman::generator<subman::subtitle> webvtt::cues(std::istream& stream) {
+  return stream_cues<webvtt_dialect>(stream);
+}
+
+void webvtt::write(subman::document const& sub,
+                   std::ostream& out) noexcept(false) {
+  write_cues<webvtt_serializer>(sub, out);
+}
+
+void webvtt::write(subman::document const& sub,
+                   std::string const& path) noexcept(false) {
+  write_cues<webvtt_serializer>(sub, path);
+}
+
+void webvtt::write(subman::generator<subman::subtitle>& cues,
+                   std::ostream& out) noexcept(false) {
+  write_cues<webvtt_serializer>(cues, out);
+}
@@ -0,0 +1,50 @@
+#ifndef FORMAT_WEBVTT_H
+#define FORMAT_WEBVTT_H
+
+#include "../document.h"
+#include "../generator.h"
+#include <istream>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace subman::formats {
+
+    /**
+     * @brief Web Video Text Tracks
+     *
+     * The cue text is lexed by the same code as subrip. "<c.class>",
+     * "<v voice>" and "<lang>" become "color" (for the colors that webvtt
+     * has classes for), "class", "voice" and "lang" attributes, and the cue
+     * settings become a "settings" attribute over the whole cue.
+     */
+    class webvtt {
+    public:
+      static constexpr std::string_view name = "webvtt";
+      static constexpr std::string_view extensions[] = {".vtt"};
+
+      webvtt() = delete;
+
+      /**
+       * @brief checks for the "WEBVTT" signature
+       */
+      static bool sniff(std::string_view head) noexcept;
+      static subman::document read(std::istream& stream) noexcept(false);
+      static subman::document read(std::string_view buffer) noexcept(false);
+      static subman::generator<subman::subtitle> cues(std::istream& stream);
+      static void write(subman::document const& sub,
+                        std::ostream& out) noexcept(false);
+      static void write(subman::document const& sub,
+                        std::string const& path) noexcept(false);
+
+      /**
+       * @brief writes the cues as they come; only a block of the output is
+       * kept in the memory
+       */
+      static void write(subman::generator<subman::subtitle>& cues,
+                        std::ostream& out) noexcept(false);
+    };
+
+} // namespace subman::formats
+
+#endif // FORMAT_WEBVTT_H
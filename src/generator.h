@@ -0,0 +1,134 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <coroutine>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <utility>
+
+namespace subman {
+
+  /**
+   * @brief A lazy, single-pass sequence of values produced by a coroutine
+   * Only the value that is being looked at is alive at any time, so it can be
+   * used to walk inputs that don't fit in the memory. The yielded values can
+   * be moved out of the iterator.
+   */
+  template <typename T>
+  class generator {
+  public:
+    struct promise_type {
+      T* current = nullptr;
+      std::exception_ptr error;
+
+      generator get_return_object() noexcept {
+        return generator{handle_type::from_promise(*this)};
+      }
+      std::suspend_always initial_suspend() const noexcept {
+        return {};
+      }
+      std::suspend_always final_suspend() const noexcept {
+        return {};
+      }
+      std::suspend_always yield_value(T& value) noexcept {
+        current = std::addressof(value);
+        return {};
+      }
+      std::suspend_always yield_value(T&& value) noexcept {
+        current = std::addressof(value);
+        return {};
+      }
+      void return_void() const noexcept {
+      }
+      void unhandled_exception() noexcept {
+        error = std::current_exception();
+      }
+
+      // co_await is not allowed in generators
+      template <typename U>
+      std::suspend_never await_transform(U&&) = delete;
+    };
+
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    struct sentinel {};
+
+    class iterator {
+      handle_type handle;
+
+    public:
+      using iterator_category = std::input_iterator_tag;
+      using difference_type = std::ptrdiff_t;
+      using value_type = T;
+      using reference = T&;
+      using pointer = T*;
+
+      iterator() = default;
+      explicit iterator(handle_type handle) noexcept : handle{handle} {
+      }
+
+      iterator& operator++() {
+        handle.resume();
+        if (handle.done() && handle.promise().error)
+          std::rethrow_exception(handle.promise().error);
+        return *this;
+      }
+      void operator++(int) {
+        ++*this;
+      }
+      reference operator*() const noexcept {
+        return *handle.promise().current;
+      }
+      pointer operator->() const noexcept {
+        return handle.promise().current;
+      }
+      bool operator==(sentinel) const noexcept {
+        return !handle || handle.done();
+      }
+    };
+
+    generator() noexcept = default;
+    generator(generator const&) = delete;
+    generator& operator=(generator const&) = delete;
+    generator(generator&& other) noexcept
+        : handle{std::exchange(other.handle, {})} {
+    }
+    generator& operator=(generator&& other) noexcept {
+      if (this != &other) {
+        if (handle)
+          handle.destroy();
+        handle = std::exchange(other.handle, {});
+      }
+      return *this;
+    }
+    ~generator() noexcept {
+      if (handle)
+        handle.destroy();
+    }
+
+    /**
+     * @brief starts the coroutine; it can only be called once
+     */
+    iterator begin() {
+      if (handle) {
+        handle.resume();
+        if (handle.done() && handle.promise().error)
+          std::rethrow_exception(handle.promise().error);
+      }
+      return iterator{handle};
+    }
+    sentinel end() const noexcept {
+      return {};
+    }
+
+  private:
+    handle_type handle;
+
+    explicit generator(handle_type handle) noexcept : handle{handle} {
+    }
+  };
+
+} // namespace subman
+
+#endif // GENERATOR_H
@@ -0,0 +1,212 @@
+#include "gzip.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+
+using subman::gzip_istreambuf;
+using subman::gzip_ostreambuf;
+
+namespace {
+
+  // "16 +" asks zlib for the gzip header and trailer
+  constexpr int gzip_window_bits = 16 + MAX_WBITS;
+
+  struct inflater {
+    z_stream zs{};
+
+    inflater() noexcept(false) {
+      if (inflateInit2(&zs, gzip_window_bits) != Z_OK)
+        throw std::invalid_argument("Error: Cannot initialize zlib.");
+    }
+    inflater(inflater const&) = delete;
+    inflater& operator=(inflater const&) = delete;
+    ~inflater() noexcept {
+      inflateEnd(&zs);
+    }
+  };
+
+  /**
+   * @brief the size of the uncompressed data that the gzip trailer records
+   * (modulo 4GiB; and only of the last member)
+   */
+  size_t recorded_size(std::string_view compressed) noexcept {
+    if (compressed.size() < 18)
+      return 0;
+    auto const p = reinterpret_cast<unsigned char const*>(
+        compressed.data() + compressed.size() - 4);
+    return static_cast<size_t>(p[0]) | (static_cast<size_t>(p[1]) << 8) |
+           (static_cast<size_t>(p[2]) << 16) |
+           (static_cast<size_t>(p[3]) << 24);
+  }
+
+} // namespace
+
+std::string subman::gunzip(std::string_view compressed) noexcept(false) {
+  inflater z;
+  auto& zs = z.zs;
+  auto const base = reinterpret_cast<Bytef const*>(compressed.data());
+  auto const consumed = [&] {
+    return static_cast<size_t>(zs.next_in - base);
+  };
+  zs.next_in = const_cast<Bytef*>(base);
+
+  std::string out;
+  out.resize(std::max(recorded_size(compressed), compressed.size() * 4));
+  size_t produced = 0;
+  for (;;) {
+    // zlib counts in 32 bits, so the big buffers are fed in pieces
+    if (zs.avail_in == 0)
+      zs.avail_in = static_cast<uInt>(
+          std::min<size_t>(compressed.size() - consumed(), UINT_MAX));
+    if (produced == out.size())
+      out.resize(std::max<size_t>(out.size() * 2, 4096));
+    zs.next_out = reinterpret_cast<Bytef*>(out.data() + produced);
+    zs.avail_out =
+        static_cast<uInt>(std::min<size_t>(out.size() - produced, UINT_MAX));
+    auto const room = zs.avail_out;
+    auto const ret = inflate(&zs, Z_NO_FLUSH);
+    produced += room - zs.avail_out;
+
+    if (ret == Z_STREAM_END) {
+      // is there another member after this one?
+      if (!is_gzip(compressed.substr(consumed())))
+        break;
+      inflateReset(&zs);
+    } else if (ret == Z_BUF_ERROR && consumed() == compressed.size()) {
+      throw std::invalid_argument("Error: The gzip data is truncated.");
+    } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+      throw std::invalid_argument("Error: The gzip data is corrupted.");
+    }
+  }
+  out.resize(produced);
+  return out;
+}
+
+gzip_istreambuf::gzip_istreambuf(std::istream& source) noexcept(false)
+    : source{source} {
+  if (inflateInit2(&zs, gzip_window_bits) != Z_OK)
+    throw std::invalid_argument("Error: Cannot initialize zlib.");
+}
+
+gzip_istreambuf::~gzip_istreambuf() noexcept {
+  inflateEnd(&zs);
+}
+
+gzip_istreambuf::int_type gzip_istreambuf::underflow() {
+  if (gptr() < egptr())
+    return traits_type::to_int_type(*gptr());
+
+  bool in_member = zs.total_in != 0;
+  while (!finished) {
+    if (zs.avail_in == 0) {
+      source.read(input.data(), static_cast<std::streamsize>(input.size()));
+      zs.next_in = reinterpret_cast<Bytef*>(input.data());
+      zs.avail_in = static_cast<uInt>(source.gcount());
+      if (zs.avail_in == 0) {
+        if (in_member)
+          throw std::invalid_argument("Error: The gzip data is truncated.");
+        finished = true;
+        break;
+      }
+    }
+    zs.next_out = reinterpret_cast<Bytef*>(output.data());
+    zs.avail_out = static_cast<uInt>(output.size());
+    auto const ret = inflate(&zs, Z_NO_FLUSH);
+    in_member = true;
+    if (ret == Z_STREAM_END) {
+      in_member = false;
+      // the magic bytes of the next member may be cut by the end of the input
+      if (zs.avail_in < 2) {
+        auto const kept = zs.avail_in;
+        std::memmove(input.data(), zs.next_in, kept);
+        source.read(input.data() + kept,
+                    static_cast<std::streamsize>(input.size() - kept));
+        zs.next_in = reinterpret_cast<Bytef*>(input.data());
+        zs.avail_in = kept + static_cast<uInt>(source.gcount());
+      }
+      // another member, or the end (and maybe some trailing garbage), the
+      // same as gunzip decides it
+      if (is_gzip({reinterpret_cast<char const*>(zs.next_in), zs.avail_in}))
+        inflateReset(&zs);
+      else
+        finished = true;
+    } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+      throw std::invalid_argument("Error: The gzip data is corrupted.");
+    }
+
+    auto const produced = output.size() - zs.avail_out;
+    if (produced != 0) {
+      setg(output.data(), output.data(), output.data() + produced);
+      return traits_type::to_int_type(output[0]);
+    }
+  }
+  return traits_type::eof();
+}
+
+gzip_ostreambuf::gzip_ostreambuf(std::ostream& sink) noexcept(false)
+    : sink{sink} {
+  if (deflateInit2(&zs,
+                   Z_DEFAULT_COMPRESSION,
+                   Z_DEFLATED,
+                   gzip_window_bits,
+                   8,
+                   Z_DEFAULT_STRATEGY) != Z_OK)
+    throw std::invalid_argument("Error: Cannot initialize zlib.");
+  setp(input.data(), input.data() + input.size());
+}
+
+gzip_ostreambuf::~gzip_ostreambuf() noexcept {
+  if (!closed) {
+    try {
+      close();
+    } catch (...) {
+      // nothing to be done in here; call close() to see the errors
+    }
+  }
+  deflateEnd(&zs);
+}
+
+void gzip_ostreambuf::deflate_input(int flush) noexcept(false) {
+  zs.next_in = reinterpret_cast<Bytef*>(pbase());
+  zs.avail_in = static_cast<uInt>(pptr() - pbase());
+  for (;;) {
+    zs.next_out = reinterpret_cast<Bytef*>(output.data());
+    zs.avail_out = static_cast<uInt>(output.size());
+    auto const ret = deflate(&zs, flush);
+    if (ret == Z_STREAM_ERROR)
+      throw std::invalid_argument("Error: Cannot compress the data.");
+    sink.write(output.data(),
+               static_cast<std::streamsize>(output.size() - zs.avail_out));
+    if (flush == Z_FINISH ? ret == Z_STREAM_END : zs.avail_out != 0)
+      break;
+  }
+  setp(input.data(), input.data() + input.size());
+  if (!sink)
+    throw std::invalid_argument("Error: Cannot write the compressed data.");
+}
+
+gzip_ostreambuf::int_type gzip_ostreambuf::overflow(int_type c) {
+  deflate_input(Z_NO_FLUSH);
+  if (!traits_type::eq_int_type(c, traits_type::eof())) {
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+  }
+  return traits_type::not_eof(c);
+}
+
+int gzip_ostreambuf::sync() {
+  if (closed)
+    return 0;
+  deflate_input(Z_NO_FLUSH);
+  sink.flush();
+  return sink ? 0 : -1;
+}
+
+void gzip_ostreambuf::close() noexcept(false) {
+  if (closed)
+    return;
+  closed = true;
+  deflate_input(Z_FINISH);
+  sink.flush();
+}
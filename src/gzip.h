@@ -0,0 +1,78 @@
+#ifndef GZIP_H
+#define GZIP_H
+
+#include <array>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <zlib.h>
+
+namespace subman {
+
+  /**
+   * @brief checks for the gzip magic bytes (1f 8b)
+   */
+  inline bool is_gzip(std::string_view raw) noexcept {
+    return raw.size() >= 2 && static_cast<unsigned char>(raw[0]) == 0x1F &&
+           static_cast<unsigned char>(raw[1]) == 0x8B;
+  }
+
+  /**
+   * @brief decompresses the whole gzip data; the members of a multi-member
+   * stream (like concatenated .gz files) are joined and the trailing garbage
+   * is ignored, just like gzip does
+   */
+  std::string gunzip(std::string_view compressed) noexcept(false);
+
+  /**
+   * @brief A stream buffer that inflates the gzip data of "source" as it's
+   * being read, so nothing but a block of it is in the memory at once
+   */
+  class gzip_istreambuf : public std::streambuf {
+    std::istream& source;
+    z_stream zs{};
+    std::array<char, 64 * 1024> input;
+    std::array<char, 64 * 1024> output;
+    bool finished = false;
+
+  protected:
+    int_type underflow() override;
+
+  public:
+    explicit gzip_istreambuf(std::istream& source) noexcept(false);
+    gzip_istreambuf(gzip_istreambuf const&) = delete;
+    gzip_istreambuf& operator=(gzip_istreambuf const&) = delete;
+    ~gzip_istreambuf() noexcept override;
+  };
+
+  /**
+   * @brief A stream buffer that deflates whatever is written into it into
+   * "sink" as a gzip stream; close() writes the end of the stream
+   */
+  class gzip_ostreambuf : public std::streambuf {
+    std::ostream& sink;
+    z_stream zs{};
+    std::array<char, 64 * 1024> input;
+    std::array<char, 64 * 1024> output;
+    bool closed = false;
+
+    void deflate_input(int flush) noexcept(false);
+
+  protected:
+    int_type overflow(int_type c) override;
+    int sync() override;
+
+  public:
+    explicit gzip_ostreambuf(std::ostream& sink) noexcept(false);
+    gzip_ostreambuf(gzip_ostreambuf const&) = delete;
+    gzip_ostreambuf& operator=(gzip_ostreambuf const&) = delete;
+    ~gzip_ostreambuf() noexcept override;
+
+    void close() noexcept(false);
+  };
+
+} // namespace subman
+
+#endif // GZIP_H
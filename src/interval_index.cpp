@@ -0,0 +1,75 @@
+#include "interval_index.h"
+#include <algorithm>
+#include <bit>
+
+using subman::interval_index;
+
+void interval_index::refresh(std::span<subtitle const> subtitles) {
+  auto const size = subtitles.size();
+  if (size > width) {
+    // it has outgrown the tree, so it's built again twice as big
+    width = std::bit_ceil(size);
+    ends.assign(width * 2, 0);
+    count = 0;
+    fresh = 0;
+  }
+  auto const last = std::max(size, count);
+  if (fresh >= last)
+    return;
+
+  // the leaves, and then the parents of them level by level
+  for (auto i = fresh; i < last; ++i)
+    ends[width + i] = i < size ? subtitles[i].timestamps.to : 0;
+  for (auto first = (width + fresh) / 2, end = (width + last - 1) / 2;
+       first != 0;
+       first /= 2, end /= 2) {
+    for (auto node = first; node <= end; ++node)
+      ends[node] = std::max(ends[node * 2], ends[node * 2 + 1]);
+  }
+  count = size;
+  fresh = size;
+}
+
+void interval_index::covering(size_t node,
+                              size_t first,
+                              size_t last,
+                              size_t before,
+                              uint64_t point,
+                              std::vector<size_t>& found) const {
+  // none of them ends after the point, or they all start too late
+  if (first >= before || ends[node] <= point)
+    return;
+  if (node >= width) {
+    found.push_back(first);
+    return;
+  }
+  auto const middle = first + (last - first) / 2;
+  covering(node * 2, first, middle, before, point, found);
+  covering(node * 2 + 1, middle, last, before, point, found);
+}
+
+std::vector<size_t>
+interval_index::overlapping(std::span<subtitle const> subtitles,
+                            duration const& d) {
+  std::vector<size_t> found;
+  if (subtitles.empty())
+    return found;
+  refresh(subtitles);
+
+  // the ones that start before it and are still going on when it starts
+  auto const start = static_cast<size_t>(
+      std::partition_point(subtitles.begin(),
+                           subtitles.end(),
+                           [&](subtitle const& sub) {
+                             return sub.timestamps.from < d.from;
+                           }) -
+      subtitles.begin());
+  covering(1, 0, width, start, d.from, found);
+
+  // and the ones that start inside it
+  for (auto i = start;
+       i < subtitles.size() && subtitles[i].timestamps.has_collide_with(d);
+       ++i)
+    found.push_back(i);
+  return found;
+}
@@ -0,0 +1,58 @@
+#ifndef INTERVAL_INDEX_H
+#define INTERVAL_INDEX_H
+
+#include "duration.h"
+#include "subtitle.h"
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace subman {
+
+  /**
+   * @brief Finds the subtitles that overlap a duration, in a list of
+   * subtitles that are sorted by their start
+   * The ones that start inside the duration are one run right after its
+   * start, and the ones that start before it are found with a tree of the
+   * furthest end in each part of the list; so it costs O(log n + k) for k
+   * overlapping subtitles (the ones that start before it cost O(log n) each,
+   * but there's usually none or one).
+   * The tree isn't kept along with the list: call "stale" with the first
+   * position that has changed, and it's brought up to date on the next
+   * lookup; changes near the end cost O(log n).
+   */
+  class interval_index {
+    std::vector<uint64_t> ends; // the tree, the leaves are at [width, 2*width)
+    size_t width = 0;           // a power of two, at least the size
+    size_t count = 0;           // how many of the leaves are in use
+    size_t fresh = 0;           // the leaves before this one are up to date
+
+    void refresh(std::span<subtitle const> subtitles);
+    void covering(size_t node,
+                  size_t first,
+                  size_t last,
+                  size_t before,
+                  uint64_t point,
+                  std::vector<size_t>& found) const;
+
+  public:
+    /**
+     * @brief the subtitles from "position" on have been changed, moved, put
+     * or removed
+     */
+    void stale(size_t position) noexcept {
+      if (position < fresh)
+        fresh = position;
+    }
+
+    /**
+     * @brief the positions of the subtitles that collide with the duration
+     * (see duration::has_collide_with), in order
+     */
+    std::vector<size_t> overlapping(std::span<subtitle const> subtitles,
+                                    duration const& d);
+  };
+
+} // namespace subman
+
+#endif // INTERVAL_INDEX_H
@@ -1,5 +1,7 @@
+#include "cache.h"
 #include "document.h"
-#include "formats/subrip.h"
+#include "formats/microdvd.h"
+#include "stdout_sink.h"
 #include "utilities.h"
 #include <algorithm>
 #include <boost/algorithm/string/split.hpp>
@@ -7,13 +9,17 @@
 #include <boost/filesystem.hpp>
 #include <boost/program_options.hpp>
 #include <functional>
+#include <future>
 #include <iostream>
 #include <map>
 #include <mutex>
 #include <numeric>
+#include <optional>
+#include <regex>
 #include <string>
 #include <string_view>
 #include <thread>
+#include <tuple>
 #include <vector>
 #include "stats.h"
 
@@ -128,7 +134,8 @@ int check_arguments(
   desc.add_options()("help,h", "Show this help page.")(
       "input-files,i",
       po::value<vector<string>>()->multitoken(),
-      "Input files")("force,f",
+      "Input files (\"-\" reads the standard input); the format is "
+      "detected from the content")("force,f",
                      po::bool_switch()
                          ->default_value(false)
                          ->implicit_value(true)
@@ -160,8 +167,19 @@ int check_arguments(
       "space-separated styles for each inputs; separate each input by comma."
       "\ne.g: normal, italic red, bold #00ff00")(
       "output-format,e",
-      po::value<string>()->default_value("auto"),
-      "Output format")(
+      po::value<vector<string>>()->multitoken()->default_value({"auto"},
+                                                                 "auto"),
+      "Output format of each output (like srt, or ndjson and columnar for "
+      "export); the last one goes on for the rest, and \"auto\" picks it "
+      "from the extension")(
+      "fps",
+      po::value<string>(),
+      "The frame rate of the frame-based formats (like 25, 23.976 or "
+      "24000/1001) when the file doesn't tell it; the default is 23.976.")(
+      "flush-size",
+      po::value<size_t>()->default_value(subman::default_flush_size),
+      "The bytes that are held before writing into the standard output; 0 "
+      "writes everything at the end.")(
       "style",
       po::bool_switch()
           ->default_value(false)
@@ -215,6 +233,16 @@ int check_arguments(
     return EXIT_FAILURE;
   }
 
+  if (vm.count("fps")) {
+    auto const fps = subman::to_framerate(vm["fps"].as<string>());
+    if (!fps) {
+      std::cerr << "Error: Invalid frame rate '" << vm["fps"].as<string>()
+                << "'." << std::endl;
+      return EXIT_FAILURE;
+    }
+    subman::formats::microdvd::frame_rate = *fps;
+  }
+
   // no command
   if (!vm.count("command")) {
     std::cerr << "Please specify a command. Use --help for more info."
@@ -237,27 +265,55 @@ int check_arguments(
   return default_action(desc, vm);
 }
 
+/**
+ * @brief the "--output-format" of the "--output" at this index
+ * @param vm
+ * @param index
+ * @return the format; the last one goes on for the rest of the outputs
+ */
+std::string output_format(boost::program_options::variables_map const& vm,
+                          size_t index) noexcept {
+  auto const& formats = vm["output-format"].as<std::vector<std::string>>();
+  if (formats.empty())
+    return "auto";
+  return formats[std::min(index, formats.size() - 1)];
+}
+
 /**
  * @brief This function will write the outputs files
  * @param vm
  * @param outputs
+ * @return EXIT_FAILURE if any of them couldn't be written
  */
-void write(boost::program_options::variables_map const& vm,
-           std::map<std::string, subman::document> const& outputs) noexcept {
+int write(boost::program_options::variables_map const& vm,
+          std::map<std::string, subman::document> const& outputs) noexcept {
   using std::string;
 
   auto is_forced = vm["force"].as<bool>();
   auto override_files = vm["override"].as<bool>();
   auto verbose = vm["verbose"].as<bool>();
-  auto format = vm["output-format"].as<string>();
   auto input_files = vm["input-files"].as<std::vector<string>>();
+  auto output_files = vm.count("output")
+                          ? vm["output"].as<std::vector<string>>()
+                          : std::vector<string>();
 
+  // the documents that go to the standard output are batched together
+  subman::stdout_sink sink{vm["flush-size"].as<size_t>()};
+  std::ostream piped{&sink};
+  piped.exceptions(std::ios::badbit);
+
+  int result = EXIT_SUCCESS;
   if (!outputs.empty()) {
     auto it = input_files.cbegin();
     for (auto const& output : outputs) {
       try {
         auto& path = output.first;
         auto& doc = output.second;
+        auto format = output_format(
+            vm,
+            static_cast<size_t>(
+                std::find(output_files.begin(), output_files.end(), path) -
+                output_files.begin()));
         if (!path.empty() && path != "--") {
           if ((!is_forced && boost::filesystem::exists(path)) ||
               (!override_files && *it == path)) {
@@ -271,35 +327,42 @@ void write(boost::program_options::variables_map const& vm,
           }
           subman::write(doc, path, format);
         } else { // printing to stdout
-          subman::formats::subrip::write(doc, std::cout);
-          std::cout << std::flush;
+          subman::write(doc, piped, "auto" == format ? "srt" : format);
         }
       } catch (std::invalid_argument const& err) {
-        if (verbose)
-          std::cerr << err.what() << std::endl;
+        std::cerr << err.what() << std::endl;
+        result = EXIT_FAILURE;
       }
       it++;
     }
   } else {
     std::cerr << "There's nothing to do." << std::endl;
   }
+
+  try {
+    std::cout << std::flush;
+    sink.close();
+  } catch (std::invalid_argument const& err) {
+    std::cerr << err.what() << std::endl;
+    result = EXIT_FAILURE;
+  }
+  return result;
 }
 
 /**
- * @brief This function will loads the input files and converts them into
- * subman::document file
+ * @brief finds the input files (walking through the directories if the user
+ * has asked for it)
  * @param vm
- * @return a vector of subman::document
+ * @return the absolute paths of the regular files
  */
-std::vector<subman::document>
-load_inputs(boost::program_options::variables_map const& vm) noexcept {
+std::vector<std::string>
+input_paths(boost::program_options::variables_map const& vm) noexcept {
   using std::function;
   using std::string;
   using std::vector;
-  using subman::document;
   namespace fs = boost::filesystem;
 
-  vector<subman::document> inputs;
+  std::vector<std::string> valid_input_files;
   auto verbose = vm["verbose"].as<bool>();
 
   // we need this field
@@ -309,14 +372,13 @@ load_inputs(boost::program_options::variables_map const& vm) noexcept {
           << "Please specify input files. Use --help for more information."
           << std::endl;
     }
-    return inputs;
+    return valid_input_files;
   }
 
   auto input_files = vm["input-files"].as<vector<string>>();
   auto is_recursive = vm["recursive"].as<bool>();
-  std::vector<std::string> valid_input_files;
 
-  // this function will load and add subtitles to the "documents" variable:
+  // this function will add the files to the "valid_input_files" variable:
   function<void(string const&)> recursive_handler;
   recursive_handler = [&](string input_path) {
     // check if the path is a directory and handle file loading:
@@ -345,25 +407,115 @@ load_inputs(boost::program_options::variables_map const& vm) noexcept {
 
   // read every input files/folders:
   for (string const& input_path : input_files) {
+    if ("-" == input_path) { // the standard input
+      valid_input_files.emplace_back(input_path);
+      continue;
+    }
     if (!fs::exists(input_path)) {
       std::cerr << "File '" << input_path << "' does not exists." << std::endl;
       continue;
     }
     recursive_handler(input_path);
   }
+  return valid_input_files;
+}
 
-  // reading the styles
-  vector<string> styles;
+/**
+ * @brief the "--styles" of each input
+ * @param vm
+ * @return a vector of space-separated styles
+ */
+std::vector<std::string>
+input_styles(boost::program_options::variables_map const& vm) noexcept {
+  std::vector<std::string> styles;
   if (vm.count("styles")) {
-    auto data = boost::algorithm::join(vm["styles"].as<vector<string>>(), " ");
+    auto data = boost::algorithm::join(
+        vm["styles"].as<std::vector<std::string>>(), " ");
     boost::algorithm::split(styles, data, [](char c) { return c == ','; });
   }
+  return styles;
+}
 
-  // handle --timing options and apply changes
-  vector<timing_options> timings;
+/**
+ * @brief the "--timing" options of each input
+ * @param vm
+ * @return a vector of timing_options
+ */
+std::vector<timing_options>
+input_timings(boost::program_options::variables_map const& vm) noexcept {
   if (vm.count("timing")) {
-    timings = transpile_timing_options(vm["timing"].as<vector<string>>());
+    return transpile_timing_options(
+        vm["timing"].as<std::vector<std::string>>());
   }
+  return {};
+}
+
+struct style_options {
+  bool bold = false;
+  bool italic = false;
+  bool underline = false;
+  std::string fontsize;
+  std::string color;
+};
+
+/**
+ * @brief transpile one input's "--styles" value into style_options struct
+ * @param style
+ * @return style_options
+ */
+style_options transpile_style_options(std::string const& style) {
+  std::vector<std::string> tags;
+  boost::algorithm::split_regex(tags, style, boost::regex("\\s+"));
+  style_options options;
+  for (auto const& tag : tags) {
+    if (tag == "normal") {
+      options.bold = false;
+      options.underline = false;
+      options.italic = false;
+    } else if (tag == "b" || tag == "bold" || tag == "strong")
+      options.bold = true;
+    else if (tag == "u" || tag == "underline" || tag == "underlined")
+      options.underline = true;
+    else if (tag == "i" || tag == "italic" || tag == "italics")
+      options.italic = true;
+    else if (boost::starts_with(tag, boost::regex("\\d")))
+      options.fontsize = tag;
+    else
+      options.color = tag;
+  }
+  return options;
+}
+
+void apply_style(style_options const& options,
+                 subman::styledstring& content) noexcept {
+  if (options.bold)
+    content.bold();
+  if (options.italic)
+    content.italic();
+  if (options.underline)
+    content.underline();
+  if (!options.fontsize.empty())
+    content.fontsize(options.fontsize);
+  if (!options.color.empty())
+    content.color(options.color);
+}
+
+/**
+ * @brief This function will loads the input files and converts them into
+ * subman::document file
+ * @param vm
+ * @return a vector of subman::document
+ */
+std::vector<subman::document>
+load_inputs(boost::program_options::variables_map const& vm) noexcept {
+  using std::string;
+  using std::vector;
+
+  vector<subman::document> inputs;
+  auto verbose = vm["verbose"].as<bool>();
+  auto valid_input_files = input_paths(vm);
+  auto styles = input_styles(vm);
+  auto timings = input_timings(vm);
 
   // reading the input files in a multithreaded environment:
   std::vector<std::thread> workers;
@@ -377,43 +529,11 @@ load_inputs(boost::program_options::variables_map const& vm) noexcept {
 
             // applying the styles to the subtitle
             if (!style.empty()) {
-              vector<string> tags;
-              boost::algorithm::split_regex(tags, style, boost::regex("\\s+"));
+              auto options = transpile_style_options(style);
               boost::algorithm::trim(style);
               boost::algorithm::to_lower(style);
-              bool bold = false;
-              bool italic = false;
-              bool underline = false;
-              string fontsize;
-              string color;
-              for (auto const& tag : tags) {
-                if (tag == "normal") {
-                  bold = false;
-                  underline = false;
-                  italic = false;
-                } else if (tag == "b" || tag == "bold" || tag == "strong")
-                  bold = true;
-                else if (tag == "u" || tag == "underline" ||
-                         tag == "underlined")
-                  underline = true;
-                else if (tag == "i" || tag == "italic" || tag == "italics")
-                  italic = true;
-                else if (boost::starts_with(tag, boost::regex("\\d")))
-                  fontsize = tag;
-                else
-                  color = tag;
-              }
               for (auto& sub : doc.subtitles) {
-                if (bold)
-                  sub.content.bold();
-                if (italic)
-                  sub.content.italic();
-                if (underline)
-                  sub.content.underline();
-                if (!fontsize.empty())
-                  sub.content.fontsize(fontsize);
-                if (!color.empty())
-                  sub.content.color(color);
+                apply_style(options, sub.content);
               }
             }
 
@@ -506,36 +626,94 @@ int search(boost::program_options::options_description const&,
                      : std::vector<std::string>();
   auto regexes = vm.count("regex") ? vm["regex"].as<std::vector<std::string>>()
                                    : std::vector<std::string>();
+  std::vector<std::regex> patterns(regexes.begin(), regexes.end());
+  auto is_wanted = [&](subman::subtitle const& sub) {
+    auto const& content = sub.content.cget_content();
+    return std::all_of(matches.begin(),
+                       matches.end(),
+                       [&](auto const& m) {
+                         return content == std::string_view{m};
+                       }) &&
+           std::all_of(contains.begin(),
+                       contains.end(),
+                       [&](auto const& c) {
+                         return content.find(c) != std::string::npos;
+                       }) &&
+           std::all_of(patterns.begin(), patterns.end(), [&](auto const& r) {
+             return std::regex_match(content, r);
+           });
+  };
 
-  auto inputs = load_inputs(vm);
+  auto verbose = vm["verbose"].as<bool>();
+  auto styles = input_styles(vm);
+  auto timings = input_timings(vm);
   auto output_files = vm.count("output")
                           ? vm["output"].as<std::vector<std::string>>()
                           : std::vector<std::string>();
   std::map<std::string, subman::document> outputs;
   auto mm = get_merge_method(vm);
 
-  auto output_files_it = std::begin(output_files);
-  for (auto const& input : inputs) {
-    auto filtered = input; // copy the input
-    for (auto& m : matches)
-      filtered = filtered.matches(m);
-    for (auto& c : contains)
-      filtered = filtered.contains(c);
-    for (auto& r : regexes)
-      filtered = filtered.regex(r);
-
-    auto output_file =
-        output_files_it == std::end(output_files) ? "" : *output_files_it;
+  // the inputs are streamed one cue at a time, so only the results are kept
+  // in the memory
+  size_t index = 0;
+  for (auto const& path : input_paths(vm)) {
+    auto options = transpile_style_options(
+        styles.size() > index ? styles[index] : std::string{});
+    auto timing = timings.size() > index ? timings[index] : timing_options{};
+    index++;
+
+    // the cues are searched after their collisions are resolved, like in
+    // the loaded document; so they don't collide with each other anymore
+    subman::document filtered;
+    auto handle = [&](subman::subtitle cue) {
+      if (!is_wanted(cue))
+        return;
+      apply_style(options, cue.content);
+      cue.timestamps.shift(timing.shift);
+      filtered.subtitles.insert(std::move(cue));
+    };
+    try {
+      // the cues that come in order don't collide, so they're searched as
+      // they're read; the others are resolved by the document
+      auto streamed = timing.gap == 0 && "-" != path;
+      if (streamed) {
+        std::optional<subman::duration> last;
+        for (auto& cue : subman::cues(path)) {
+          if (last &&
+              !subman::document_builder::in_order(*last, cue.timestamps)) {
+            streamed = false;
+            break;
+          }
+          last = cue.timestamps;
+          handle(std::move(cue));
+        }
+      }
+      if (!streamed) {
+        // the gaps depend on the neighbours too; and the standard input
+        // can't be read again, so it's loaded right away
+        filtered = subman::document{};
+        auto doc = subman::load(path);
+        if (timing.gap != 0)
+          doc.gap(timing.gap);
+        for (auto const& sub : doc.subtitles)
+          handle(sub);
+      }
+    } catch (std::exception const& e) {
+      std::cerr << "Error: " << e.what() << '\n';
+      continue;
+    }
+    if (verbose)
+      std::cout << "Document searched: " << path << '\n';
+
+    auto output_file = output_files.empty() ? "" : output_files.front();
     if (outputs.find(output_file) == outputs.cend())
       outputs[output_file] = std::move(filtered);
     else
-      outputs[output_file] = subman::merge(outputs[output_file], filtered, mm);
+      subman::merge_in_place(outputs[output_file], filtered, mm);
   }
 
   // write to the outputs
-  write(vm, outputs);
-
-  return EXIT_SUCCESS;
+  return write(vm, outputs);
 }
 
 /**
@@ -569,31 +747,30 @@ int merge(boost::program_options::options_description const& /* desc */,
   outputs[output_files.empty() ? "" : output_files[0]] = doc;
 
   // write the documents
-  write(vm, outputs);
-
-  return EXIT_SUCCESS;
+  return write(vm, outputs);
 }
 
 
 
 int book(boost::program_options::options_description const& /* desc */,
           boost::program_options::variables_map const& vm) noexcept {
-  using std::map;
-  using std::string;
-  using std::vector;
-  using subman::document;
-
-  map<string, document> outputs;
-  auto inputs = load_inputs(vm);
-  if (inputs.empty()) {
+  auto paths = input_paths(vm);
+  if (paths.empty()) {
     std::cerr << "There's no input file to work on. Please specify some."
               << std::endl;
     return EXIT_FAILURE;
   }
 
+  // streaming the cues, so the inputs don't need to fit in the memory
   subman::stats _stats;
-  for (auto const& input : inputs) {
-    _stats.process(input);
+  for (auto const& path : paths) {
+    try {
+      for (auto const& cue : subman::cues(path)) {
+        _stats.process(cue);
+      }
+    } catch (std::exception const& e) {
+      std::cerr << "Error: " << e.what() << '\n';
+    }
   }
 
 
@@ -651,9 +828,7 @@ int style(boost::program_options::options_description const& /* desc */,
                  });
 
   // write into their outputs
-  write(vm, outputs);
-
-  return EXIT_SUCCESS;
+  return write(vm, outputs);
 }
 
 /**
@@ -683,12 +858,263 @@ int append(boost::program_options::options_description const& /* desc */,
 
   std::map<std::string, subman::document> outputs;
   outputs[std::move(output_file)] = std::move(output);
-  write(vm, outputs);
+  return write(vm, outputs);
+}
 
-  return EXIT_SUCCESS;
+/**
+ * @brief streams each input file into its output file (or the standard
+ * output) one cue at a time, so the memory doesn't grow with the files
+ * @param vm
+ * @param streamer converts one file: (input, output, format, flush size)
+ * @return
+ */
+int stream_each(boost::program_options::variables_map const& vm,
+                std::function<void(std::string const&,
+                                   std::string const&,
+                                   std::string const&,
+                                   size_t)> const& streamer) noexcept {
+  auto paths = input_paths(vm);
+  if (paths.empty()) {
+    std::cerr << "There's no input file to work on. Please specify some."
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  auto output_files = vm.count("output")
+                          ? vm["output"].as<std::vector<std::string>>()
+                          : std::vector<std::string>();
+  auto is_forced = vm["force"].as<bool>();
+  auto verbose = vm["verbose"].as<bool>();
+  auto window = vm["flush-size"].as<size_t>();
+
+  int result = EXIT_SUCCESS;
+  size_t index = 0;
+  for (auto const& path : paths) {
+    auto output = output_files.size() > index ? output_files[index] : "";
+    auto format = output_format(vm, index);
+    index++;
+    if (!output.empty() && output != "--" && !is_forced &&
+        boost::filesystem::exists(output)) {
+      std::cerr << "Error: File '" + output + "' already exists." << std::endl;
+      result = EXIT_FAILURE;
+      continue;
+    }
+    try {
+      streamer(path, output, format, window);
+      if (verbose)
+        std::cerr << "Document streamed: " << path << '\n';
+    } catch (std::exception const& e) {
+      std::cerr << e.what() << '\n';
+      result = EXIT_FAILURE;
+    }
+  }
+  return result;
+}
+
+/**
+ * @brief convert the input files into other subtitle formats
+ */
+int convert(boost::program_options::options_description const& /* desc */,
+            boost::program_options::variables_map const& vm) noexcept {
+  return stream_each(vm, subman::convert);
+}
+
+/**
+ * @brief export the cues of the input files for the analytics tools, as
+ * NDJSON or in columns
+ */
+int export_cues(boost::program_options::options_description const& /* desc */,
+                boost::program_options::variables_map const& vm) noexcept {
+  return stream_each(vm, subman::export_to);
+}
+
+/**
+ * @brief write the caches of the input files next to them, so the next loads
+ * don't parse them again
+ * @param vm
+ * @return
+ */
+int cache(boost::program_options::options_description const& /* desc */,
+          boost::program_options::variables_map const& vm) noexcept {
+  auto paths = input_paths(vm);
+  if (paths.empty()) {
+    std::cerr << "There's no input file to work on. Please specify some."
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  auto verbose = vm["verbose"].as<bool>();
+  int result = EXIT_SUCCESS;
+  for (auto const& path : paths) {
+    if ("-" == path)
+      continue;
+    try {
+      if (!subman::refresh_cache(path)) {
+        std::cerr << "Error: '" << path
+                  << "' was changed while it was read; its cache is not "
+                     "written.\n";
+        result = EXIT_FAILURE;
+        continue;
+      }
+      if (verbose)
+        std::cout << "Cache written: " << subman::cache_path(path) << '\n';
+    } catch (std::exception const& e) {
+      std::cerr << e.what() << '\n';
+      result = EXIT_FAILURE;
+    }
+  }
+  return result;
+}
+
+/**
+ * @brief whether the two paths are the same existing file
+ */
+bool is_same_file(std::string const& a, std::string const& b) noexcept {
+  boost::system::error_code error;
+  return boost::filesystem::equivalent(a, b, error) && !error;
+}
+
+/**
+ * @brief parse each input once and write it into several outputs at once
+ * Every input gets the same number of "--output"s, one after another, and
+ * "--output-format", "--styles" and "--timing" go with each output. The
+ * outputs with the same styles and timings share one document; the ones
+ * without any share the loaded one.
+ * @param vm
+ * @return
+ */
+int fanout(boost::program_options::options_description const& /* desc */,
+           boost::program_options::variables_map const& vm) noexcept {
+  using std::string;
+
+  auto paths = input_paths(vm);
+  if (paths.empty()) {
+    std::cerr << "There's no input file to work on. Please specify some."
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  auto output_files = vm.count("output")
+                          ? vm["output"].as<std::vector<string>>()
+                          : std::vector<string>();
+  if (output_files.empty() || output_files.size() % paths.size() != 0) {
+    std::cerr << "Error: Every input needs the same number of outputs."
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  // two writers can't share a file
+  std::vector<string> files;
+  for (auto const& path : output_files)
+    if (!path.empty() && path != "--")
+      files.push_back(
+          boost::filesystem::absolute(path).lexically_normal().string());
+  std::sort(files.begin(), files.end());
+  if (auto const repeated = std::adjacent_find(files.begin(), files.end());
+      repeated != files.end()) {
+    std::cerr << "Error: File '" + *repeated + "' is given more than once."
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  auto const per_input = output_files.size() / paths.size();
+  auto is_forced = vm["force"].as<bool>();
+  auto override_files = vm["override"].as<bool>();
+  auto verbose = vm["verbose"].as<bool>();
+  auto styles = input_styles(vm);
+  auto timings = input_timings(vm);
+
+  subman::stdout_sink sink{vm["flush-size"].as<size_t>()};
+  std::ostream piped{&sink};
+  piped.exceptions(std::ios::badbit);
+
+  int result = EXIT_SUCCESS;
+  for (size_t i = 0; i < paths.size(); ++i) {
+    subman::document doc;
+    try {
+      doc = subman::load(paths[i]);
+    } catch (std::exception const& e) {
+      std::cerr << e.what() << '\n';
+      result = EXIT_FAILURE;
+      continue;
+    }
+
+    struct target {
+      string path;
+      string format;
+      subman::document const* doc;
+    };
+    std::vector<target> targets;
+    std::map<std::tuple<string, size_t, int64_t>, subman::document> variants;
+    for (auto index = i * per_input; index < (i + 1) * per_input; ++index) {
+      auto style = styles.size() > index ? styles[index] : string{};
+      auto timing = timings.size() > index ? timings[index] : timing_options{};
+      boost::algorithm::trim(style);
+      auto const* branch = &doc;
+      if (!style.empty() || timing.gap != 0 || timing.shift != 0) {
+        auto [variant, fresh] =
+            variants.try_emplace({style, timing.gap, timing.shift});
+        if (fresh) {
+          variant->second = doc;
+          auto options = transpile_style_options(style);
+          for (auto& sub : variant->second.subtitles)
+            apply_style(options, sub.content);
+          if (timing.gap != 0)
+            variant->second.gap(timing.gap);
+          if (timing.shift != 0)
+            variant->second.shift(timing.shift);
+        }
+        branch = &variant->second;
+      }
+      targets.push_back(
+          {output_files[index], output_format(vm, index), branch});
+    }
+
+    // the files are written concurrently; the standard output one by one
+    std::vector<std::pair<string, std::future<void>>> writers;
+    for (auto const& t : targets) {
+      if (t.path.empty() || t.path == "--")
+        continue;
+      if ((!is_forced && boost::filesystem::exists(t.path)) ||
+          (!override_files && is_same_file(t.path, paths[i]))) {
+        std::cerr << "Error: File '" + t.path + "' already exists."
+                  << std::endl;
+        result = EXIT_FAILURE;
+        continue;
+      }
+      auto writer = [&t] { subman::write(*t.doc, t.path, t.format); };
+      writers.emplace_back(t.path, std::async(std::launch::async, writer));
+    }
+    for (auto const& t : targets) {
+      if (!t.path.empty() && t.path != "--")
+        continue;
+      try {
+        subman::write(*t.doc, piped, "auto" == t.format ? "srt" : t.format);
+      } catch (std::exception const& e) {
+        std::cerr << e.what() << '\n';
+        result = EXIT_FAILURE;
+      }
+    }
+    for (auto& [path, writer] : writers) {
+      try {
+        writer.get();
+        if (verbose)
+          std::cerr << "Written to file: " << path << '\n';
+      } catch (std::exception const& e) {
+        std::cerr << e.what() << '\n';
+        result = EXIT_FAILURE;
+      }
+    }
+  }
+
+  try {
+    std::cout << std::flush;
+    sink.close();
+  } catch (std::invalid_argument const& err) {
+    std::cerr << err.what() << std::endl;
+    result = EXIT_FAILURE;
+  }
+  return result;
 }
 
 auto main(int argc, char** argv) -> int {
+  // the standard output is not shared with the C streams
+  std::ios::sync_with_stdio(false);
   return check_arguments(argc,
                          argv,
                          {{"help", print_help},
@@ -696,6 +1122,10 @@ auto main(int argc, char** argv) -> int {
                           {"book", book},
                           {"style", style},
                           {"append", append},
+                          {"cache", cache},
+                          {"convert", convert},
+                          {"export", export_cues},
+                          {"fanout", fanout},
                           {"search", search}},
                          print_help);
 }
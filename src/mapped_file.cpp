@@ -0,0 +1,98 @@
+#include "mapped_file.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+using subman::mapped_file;
+using subman::output_file;
+
+mapped_file::mapped_file(std::string const& path) noexcept(false) {
+  auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+    throw std::invalid_argument("Error: Cannot open '" + path + "'.");
+
+  struct stat info {};
+  if (::fstat(fd, &info) == -1) {
+    ::close(fd);
+    throw std::invalid_argument("Error: Cannot read '" + path + "'.");
+  }
+
+  // mmap doesn't like empty files; an empty view will do
+  auto const size = static_cast<size_t>(info.st_size);
+  if (size != 0) {
+    auto data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      ::close(fd);
+      throw std::invalid_argument("Error: Cannot map '" + path + "'.");
+    }
+    ::madvise(data, size, MADV_SEQUENTIAL);
+    mapping = {static_cast<char const*>(data), size};
+  }
+  ::close(fd);
+}
+
+mapped_file::~mapped_file() noexcept {
+  if (!mapping.empty())
+    ::munmap(const_cast<char*>(mapping.data()), mapping.size());
+}
+
+output_file::output_file(std::string path) noexcept(false)
+    : path{std::move(path)} {
+  fd = ::open(this->path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+              0666);
+  if (fd == -1)
+    throw std::invalid_argument("Error: Cannot open file '" + this->path +
+                                "'");
+  struct stat info {};
+  regular = ::fstat(fd, &info) == 0 && S_ISREG(info.st_mode);
+}
+
+output_file::~output_file() noexcept {
+  if (fd != -1)
+    ::close(fd);
+}
+
+void output_file::resize(size_t size) noexcept(false) {
+  if (::ftruncate(fd, static_cast<off_t>(size)) == -1)
+    throw std::invalid_argument("Error: Cannot write '" + path + "'.");
+}
+
+void output_file::write_at(std::string_view data,
+                          size_t offset) noexcept(false) {
+  while (!data.empty()) {
+    auto const written = ::pwrite(
+        fd, data.data(), data.size(), static_cast<off_t>(offset));
+    if (written == -1) {
+      if (errno == EINTR)
+        continue;
+      throw std::invalid_argument("Error: Cannot write '" + path + "'.");
+    }
+    data.remove_prefix(static_cast<size_t>(written));
+    offset += static_cast<size_t>(written);
+  }
+}
+
+void output_file::write(std::string_view data) noexcept(false) {
+  while (!data.empty()) {
+    auto const written = ::write(fd, data.data(), data.size());
+    if (written == -1) {
+      if (errno == EINTR)
+        continue;
+      throw std::invalid_argument("Error: Cannot write '" + path + "'.");
+    }
+    data.remove_prefix(static_cast<size_t>(written));
+  }
+}
+
+void output_file::close() noexcept(false) {
+  if (fd == -1)
+    return;
+  auto const closed = ::close(fd);
+  fd = -1;
+  if (closed == -1)
+    throw std::invalid_argument("Error: Cannot write '" + path + "'.");
+}
@@ -0,0 +1,62 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <string_view>
+
+namespace subman {
+
+  /**
+   * @brief A read-only memory mapping of a whole file
+   * The mapping is released when this object is destroyed, so the views
+   * that point into it should not outlive it.
+   */
+  class mapped_file {
+    std::string_view mapping;
+
+  public:
+    explicit mapped_file(std::string const& path) noexcept(false);
+    mapped_file(mapped_file const&) = delete;
+    mapped_file& operator=(mapped_file const&) = delete;
+    ~mapped_file() noexcept;
+
+    auto view() const noexcept -> std::string_view {
+      return mapping;
+    }
+  };
+
+  /**
+   * @brief A file that is opened for writing (and emptied)
+   * A regular file can then be given its final size and written at any
+   * offset, from any number of threads at once; the others (the pipes and
+   * the devices, like /dev/null) can only be written in order.
+   */
+  class output_file {
+    std::string path;
+    int fd = -1;
+    bool regular = false;
+
+  public:
+    explicit output_file(std::string path) noexcept(false);
+    output_file(output_file const&) = delete;
+    output_file& operator=(output_file const&) = delete;
+    ~output_file() noexcept;
+
+    // whether it can be resized and written at offsets
+    bool is_regular() const noexcept {
+      return regular;
+    }
+
+    void resize(size_t size) noexcept(false);
+    void write_at(std::string_view data, size_t offset) noexcept(false);
+
+    // writes after what's been written so far
+    void write(std::string_view data) noexcept(false);
+
+    // closes the file; the errors of the delayed writes show up in here
+    void close() noexcept(false);
+  };
+
+} // namespace subman
+
+#endif // MAPPED_FILE_H
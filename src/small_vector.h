@@ -0,0 +1,259 @@
+#ifndef SMALL_VECTOR_H
+#define SMALL_VECTOR_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <utility>
+
+namespace subman {
+
+  /**
+   * @brief A vector that keeps its first N elements inside itself
+   * Only the ones after that go to the allocator; the elements themselves are
+   * made with the allocator too (like in the containers of std::pmr), so a
+   * small_vector in an arena keeps everything it has in there.
+   */
+  template <typename T, size_t N>
+  class small_vector {
+  public:
+    using value_type = T;
+    using size_type = uint32_t;
+    using allocator_type = std::pmr::polymorphic_allocator<T>;
+    using iterator = T*;
+    using const_iterator = T const*;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  private:
+    allocator_type alloc;
+    T* items = inline_items();
+    size_type count = 0;
+    size_type capacity = N;
+    alignas(T) std::byte buffer[N * sizeof(T)];
+
+    T* inline_items() noexcept {
+      return reinterpret_cast<T*>(buffer);
+    }
+    bool is_inline() const noexcept {
+      return capacity == N;
+    }
+
+    // moves the elements into a bigger place
+    void grow(size_type wanted) {
+      auto const bigger = std::max<size_type>(wanted, capacity * 2);
+      T* const moved = alloc.allocate(bigger);
+      for (size_type i = 0; i < count; ++i) {
+        alloc.construct(moved + i, std::move(items[i]));
+        std::destroy_at(items + i);
+      }
+      if (!is_inline())
+        alloc.deallocate(items, capacity);
+      items = moved;
+      capacity = bigger;
+    }
+
+    // takes the elements of "other" when they're in the same allocator and
+    // not inside it; otherwise they're moved one by one
+    void take(small_vector& other) {
+      if (!other.is_inline() && alloc == other.alloc) {
+        items = std::exchange(other.items, other.inline_items());
+        count = std::exchange(other.count, 0);
+        capacity = std::exchange(other.capacity, N);
+        return;
+      }
+      reserve(other.count);
+      for (auto& item : other)
+        alloc.construct(items + count++, std::move(item));
+      other.clear();
+    }
+
+    void release() noexcept {
+      clear();
+      if (!is_inline())
+        alloc.deallocate(items, capacity);
+      items = inline_items();
+      capacity = N;
+    }
+
+  public:
+    small_vector() noexcept = default;
+    explicit small_vector(allocator_type const& alloc) noexcept
+        : alloc{alloc} {
+    }
+    small_vector(small_vector const& other)
+        : small_vector{other, allocator_type{}} {
+    }
+    small_vector(small_vector const& other, allocator_type const& alloc)
+        : alloc{alloc} {
+      reserve(other.count);
+      for (auto const& item : other)
+        this->alloc.construct(items + count++, item);
+    }
+    small_vector(small_vector&& other) noexcept : alloc{other.alloc} {
+      take(other);
+    }
+    small_vector(small_vector&& other, allocator_type const& alloc)
+        : alloc{alloc} {
+      take(other);
+    }
+    small_vector& operator=(small_vector const& other) {
+      if (this != &other) {
+        clear();
+        reserve(other.count);
+        for (auto const& item : other)
+          alloc.construct(items + count++, item);
+      }
+      return *this;
+    }
+    small_vector& operator=(small_vector&& other) noexcept {
+      if (this != &other) {
+        release();
+        take(other);
+      }
+      return *this;
+    }
+    ~small_vector() noexcept {
+      release();
+    }
+
+    allocator_type get_allocator() const noexcept {
+      return alloc;
+    }
+
+    void reserve(size_t wanted) {
+      if (wanted > capacity)
+        grow(static_cast<size_type>(wanted));
+    }
+
+    template <typename... Args>
+    T& emplace_back(Args&&... args) {
+      if (count == capacity)
+        grow(count + 1);
+      alloc.construct(items + count, std::forward<Args>(args)...);
+      return items[count++];
+    }
+    void push_back(T const& item) {
+      emplace_back(item);
+    }
+    void push_back(T&& item) {
+      emplace_back(std::move(item));
+    }
+
+    /**
+     * @brief puts the element right before "pos"
+     */
+    template <typename... Args>
+    iterator emplace(const_iterator pos, Args&&... args) {
+      auto const index = pos - items;
+      emplace_back(std::forward<Args>(args)...);
+      std::rotate(items + index, items + count - 1, items + count);
+      return items + index;
+    }
+
+    iterator erase(const_iterator first, const_iterator last) {
+      auto const index = first - items;
+      auto const end =
+          std::move(items + (last - items), items + count, items + index);
+      std::destroy(end, items + count);
+      count = static_cast<size_type>(end - items);
+      return items + index;
+    }
+    iterator erase(const_iterator pos) {
+      return erase(pos, pos + 1);
+    }
+
+    void clear() noexcept {
+      std::destroy(items, items + count);
+      count = 0;
+    }
+
+    size_t size() const noexcept {
+      return count;
+    }
+    bool empty() const noexcept {
+      return count == 0;
+    }
+
+    T& operator[](size_t i) noexcept {
+      return items[i];
+    }
+    T const& operator[](size_t i) const noexcept {
+      return items[i];
+    }
+    T& front() noexcept {
+      return items[0];
+    }
+    T const& front() const noexcept {
+      return items[0];
+    }
+    T& back() noexcept {
+      return items[count - 1];
+    }
+    T const& back() const noexcept {
+      return items[count - 1];
+    }
+
+    iterator begin() noexcept {
+      return items;
+    }
+    iterator end() noexcept {
+      return items + count;
+    }
+    const_iterator begin() const noexcept {
+      return items;
+    }
+    const_iterator end() const noexcept {
+      return items + count;
+    }
+    const_iterator cbegin() const noexcept {
+      return items;
+    }
+    const_iterator cend() const noexcept {
+      return items + count;
+    }
+    reverse_iterator rbegin() noexcept {
+      return reverse_iterator{end()};
+    }
+    reverse_iterator rend() noexcept {
+      return reverse_iterator{begin()};
+    }
+    const_reverse_iterator rbegin() const noexcept {
+      return const_reverse_iterator{end()};
+    }
+    const_reverse_iterator rend() const noexcept {
+      return const_reverse_iterator{begin()};
+    }
+
+    bool operator==(small_vector const& other) const noexcept {
+      return std::equal(begin(), end(), other.begin(), other.end());
+    }
+    bool operator!=(small_vector const& other) const noexcept {
+      return !(*this == other);
+    }
+  };
+
+  /**
+   * @brief removes the elements that "pred" says so, like std::erase_if
+   */
+  template <typename T, size_t N, typename Pred>
+  size_t erase_if(small_vector<T, N>& v, Pred pred) {
+    auto kept = v.begin();
+    for (auto& item : v) {
+      if (pred(item))
+        continue;
+      if (&*kept != &item)
+        *kept = std::move(item);
+      ++kept;
+    }
+    auto const removed = static_cast<size_t>(v.end() - kept);
+    v.erase(kept, v.end());
+    return removed;
+  }
+
+} // namespace subman
+
+#endif // SMALL_VECTOR_H
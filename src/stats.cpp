@@ -1,6 +1,7 @@
 // Created by moisrex on 9/14/20.
 
 #include "stats.h"
+#include <algorithm>
 
 void subman::stats::process(const subman::subtitle &sub) {
   process(sub.content.cget_content());
@@ -14,25 +15,25 @@ void subman::stats::process(const subman::document &doc) {
 void subman::stats::process(std::string_view content) {
   auto start_it = content.begin();
   auto end_it = start_it;
-  for (; end_it != content.end(); ++end_it) {
-    switch (*end_it) {
-    case ' ':
-    case '\n':
-    case '\t': {
-      auto str = std::string_view{start_it, static_cast<size_t>(end_it - start_it)};
+  for (;; ++end_it) {
+    if (end_it != content.end() && *end_it != ' ' && *end_it != '\n' &&
+        *end_it != '\t')
+      continue;
+    auto str = std::string_view{start_it, static_cast<size_t>(end_it - start_it)};
+    if (!str.empty()) {
       auto found = std::find(words.begin(), words.end(), str);
       if (found == words.end()) {
         words.push_back(word_type{
-            .word = str,
-            .examples{content}
+            .word = std::string{str},
+            .examples{std::string{content}}
         });
-      } else {
-        found->examples.push_back(content);
+      } else if (found->examples.size() < max_examples) {
+        found->examples.emplace_back(content);
       }
-      start_it = end_it;
-      continue;
-    }
     }
+    if (end_it == content.end())
+      break;
+    start_it = std::next(end_it);
   }
 }
 bool subman::word_type::operator==(std::string_view str) const noexcept {
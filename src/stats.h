@@ -13,14 +13,20 @@
 namespace subman {
 
   struct word_type {
-    std::string_view word;
-    std::vector<std::string_view> examples;
+    std::string word;
+    std::vector<std::string> examples;
 
     bool operator==(std::string_view) const noexcept;
   };
 
+  /**
+   * @brief word statistics of the processed subtitles
+   * The words and examples are copied, so the subtitles can be streamed and
+   * thrown away right after being processed.
+   */
   struct stats {
     std::vector<word_type> words;
+    size_t max_examples = 3; // per word
 
     void process(std::string_view content);
     void process(document const &doc);
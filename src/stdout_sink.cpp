@@ -0,0 +1,101 @@
+#include "stdout_sink.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <stdexcept>
+#include <sys/uio.h>
+
+using subman::stdout_sink;
+
+namespace {
+
+  constexpr size_t block_size = 256 * 1024;
+
+} // namespace
+
+stdout_sink::stdout_sink(size_t flush_size, int fd) noexcept
+    : fd{fd},
+      flush_size{flush_size} {}
+
+stdout_sink::~stdout_sink() noexcept {
+  try {
+    close();
+  } catch (...) {
+    // nothing to be done in here; call close() to see the errors
+  }
+}
+
+void stdout_sink::seal() {
+  if (pptr() == pbase())
+    return;
+  current.resize(static_cast<size_t>(pptr() - pbase()));
+  held += current.size();
+  blocks.emplace_back(std::move(current));
+  current = std::string{};
+  setp(nullptr, nullptr);
+}
+
+void stdout_sink::drain() noexcept(false) {
+  seal();
+  std::vector<iovec> pieces;
+  pieces.reserve(std::min<size_t>(blocks.size(), IOV_MAX));
+  for (size_t first = 0; first < blocks.size();) {
+    pieces.clear();
+    for (auto i = first; i < blocks.size() && pieces.size() < IOV_MAX; ++i)
+      pieces.push_back({blocks[i].data(), blocks[i].size()});
+
+    auto const written =
+        ::writev(fd, pieces.data(), static_cast<int>(pieces.size()));
+    if (written == -1) {
+      if (errno == EINTR)
+        continue;
+      throw std::invalid_argument("Error: Cannot write into the output.");
+    }
+
+    // dropping what is written; the partly written block keeps its rest
+    this->written = true;
+    auto left = static_cast<size_t>(written);
+    for (; first < blocks.size() && left >= blocks[first].size(); ++first) {
+      left -= blocks[first].size();
+      spare.emplace_back(std::move(blocks[first]));
+    }
+    if (left != 0)
+      blocks[first].erase(0, left);
+  }
+  blocks.clear();
+  held = 0;
+}
+
+stdout_sink::int_type stdout_sink::overflow(int_type c) {
+  if (closed)
+    return traits_type::eof();
+  seal();
+  if (flush_size != 0 && held >= flush_size)
+    drain();
+
+  if (!spare.empty()) {
+    current = std::move(spare.back());
+    spare.pop_back();
+  }
+  current.resize(block_size);
+  setp(current.data(), current.data() + current.size());
+  if (!traits_type::eq_int_type(c, traits_type::eof())) {
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+  }
+  return traits_type::not_eof(c);
+}
+
+void stdout_sink::discard() noexcept {
+  setp(nullptr, nullptr);
+  blocks.clear();
+  held = 0;
+  closed = true;
+}
+
+void stdout_sink::close() noexcept(false) {
+  if (closed)
+    return;
+  closed = true;
+  drain();
+}
@@ -0,0 +1,57 @@
+#ifndef STDOUT_SINK_H
+#define STDOUT_SINK_H
+
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace subman {
+
+  // what the sink holds before it writes; 0 holds everything until close()
+  constexpr size_t default_flush_size = 4 * 1024 * 1024;
+
+  /**
+   * @brief A stream buffer that writes into a file descriptor (the standard
+   * output, usually) in big batches
+   * The data is gathered in blocks, which are handed to the kernel with a
+   * single writev once "flush_size" bytes are held, and when the sink is
+   * closed. Flushing the stream doesn't write anything, so the writers can
+   * flush all they want.
+   */
+  class stdout_sink : public std::streambuf {
+    int fd;
+    size_t flush_size;
+    std::vector<std::string> blocks; // the full blocks
+    std::vector<std::string> spare;  // the written blocks, to be reused
+    std::string current;             // the put area
+    size_t held = 0;                 // the size of the full blocks
+    bool closed = false;
+    bool written = false; // has anything reached the file yet
+
+    void seal();
+    void drain() noexcept(false);
+
+  protected:
+    int_type overflow(int_type c) override;
+
+  public:
+    explicit stdout_sink(size_t flush_size = default_flush_size,
+                         int fd = 1) noexcept;
+    stdout_sink(stdout_sink const&) = delete;
+    stdout_sink& operator=(stdout_sink const&) = delete;
+    ~stdout_sink() noexcept override;
+
+    // writes whatever is held; the sink can't be used after this
+    void close() noexcept(false);
+
+    auto has_written() const noexcept -> bool {
+      return written;
+    }
+
+    // drops whatever is held and closes the sink
+    void discard() noexcept;
+  };
+
+} // namespace subman
+
+#endif // STDOUT_SINK_H
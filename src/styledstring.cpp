@@ -7,21 +7,24 @@ using subman::range;
 using subman::styledstring;
 
 // constructors:
-styledstring::styledstring(decltype(content)&& _content,
-                           decltype(attrs)&& _attrs)
-    : content{std::move(_content)}, attrs{std::move(_attrs)} {
+styledstring::styledstring(allocator_type const& alloc) noexcept
+    : content{alloc}, attrs{alloc} {
 }
-styledstring::styledstring(decltype(content) const& _content,
-                           decltype(attrs) _attrs)
-    : styledstring(decltype(content)(_content), std::move(_attrs)) {
+styledstring::styledstring(styledstring const& sstr,
+                           allocator_type const& alloc)
+    : content{sstr.content, alloc}, attrs{sstr.attrs, alloc} {
+}
+styledstring::styledstring(styledstring&& sstr, allocator_type const& alloc)
+    : content{std::move(sstr.content), alloc},
+      attrs{std::move(sstr.attrs), alloc} {
 }
 styledstring::styledstring(decltype(content)&& _content,
-                           decltype(attrs) const& _attrs)
-    : styledstring(std::move(_content), decltype(attrs)(_attrs)) {
+                           decltype(attrs)&& _attrs)
+    : content{std::move(_content)}, attrs{std::move(_attrs)} {
 }
-styledstring::styledstring(decltype(content) const& _content,
-                           decltype(attrs) const& _attrs)
-    : styledstring(decltype(content)(_content), decltype(attrs)(_attrs)) {
+styledstring::styledstring(std::string_view _content,
+                           allocator_type const& alloc)
+    : content{_content, alloc}, attrs{alloc} {
 }
 
 bool range::operator<(range const& r) const noexcept {
@@ -50,8 +53,24 @@ bool range::is_collided(range const& r) const noexcept {
          (finish >= r.start && finish < r.finish);
 }
 
+std::string_view subman::name_of(attr_kind kind) noexcept {
+  static constexpr std::string_view names[attr_kinds] = {
+      "b", "i", "u", "color", "fontsize", "class", "voice", "lang", "settings"};
+  return names[static_cast<size_t>(kind)];
+}
+
+std::optional<subman::attr_kind>
+subman::attr_kind_of(std::string_view name) noexcept {
+  for (size_t i = 0; i < attr_kinds; ++i) {
+    auto const kind = static_cast<attr_kind>(i);
+    if (name_of(kind) == name)
+      return kind;
+  }
+  return std::nullopt;
+}
+
 bool attr::operator==(attr const& a) const noexcept {
-  return a.pos == pos && name == a.name && a.value == value;
+  return a.pos == pos && kind == a.kind && a.value == value;
 }
 bool attr::operator!=(attr const& a) const noexcept {
   return !(a == *this);
@@ -95,7 +114,7 @@ styledstring styledstring::operator+(std::string const& str) const noexcept {
 styledstring&& styledstring::add(std::string&& str,
                                  styledstring&& sstr) noexcept {
   sstr.shift_ranges(str.size());
-  sstr.content = std::move(str) + sstr.content;
+  sstr.content.insert(0, str);
   return std::move(sstr);
 }
 styledstring&& operator+(std::string&& str, styledstring&& sstr) noexcept {
@@ -171,7 +190,7 @@ void styledstring::append_line(styledstring&& line) {
     _attr.pos.finish += start_pos;
     attrs.emplace_back(std::move(_attr));
   }
-  append_line(std::move(line.get_content()));
+  append_line(std::string{line.get_content()});
 }
 void styledstring::append_line(styledstring const& line) {
   append_line(styledstring(line));
@@ -196,17 +215,17 @@ void styledstring::put_attribute(attr&& a) noexcept {
   //  }
 
   // we are promising that the subtitles will not collide with each other
-  for (auto it = begin(attrs); it != attrs.end(); ++it) {
+  for (auto it = attrs.begin(); it != attrs.end(); ++it) {
     if (!it->pos.is_collided(a.pos))
       continue;
     if (*it == a) { // it's useless to insert something that it's already there
       return;       // ignore the whole thing
     }
-    if (it->pos == a.pos && it->name == a.name && it->value != a.value) {
+    if (it->pos == a.pos && it->kind == a.kind && it->value != a.value) {
       it->value = a.value;
       return; // done with it
     }
-    if (it->name == a.name && it->value == a.value &&
+    if (it->kind == a.kind && it->value == a.value &&
         it->pos.is_collided(a.pos)) {
       auto _min = std::min(it->pos.start, a.pos.start);
       auto _max = std::max(it->pos.finish, a.pos.finish);
@@ -227,20 +246,20 @@ void styledstring::put_attribute(attr const& a) noexcept {
 }
 
 void styledstring::italic(range const& r) noexcept {
-  put_attribute(attr{r, "i"});
+  put_attribute(attr{r, attr_kind::italic});
 }
 void styledstring::color(range const& r, std::string&& _color) noexcept {
-  put_attribute(attr{r, "color", std::move(_color)});
+  put_attribute(attr{r, attr_kind::color, _color});
 }
 void styledstring::fontsize(range const& r, std::string&& _fontsize) noexcept {
-  put_attribute(attr{r, "fontsize", std::move(_fontsize)});
+  put_attribute(attr{r, attr_kind::fontsize, _fontsize});
 }
 
 void styledstring::bold(range const& r) noexcept {
-  put_attribute(attr{r, "b"});
+  put_attribute(attr{r, attr_kind::bold});
 }
 void styledstring::underline(range const& r) noexcept {
-  put_attribute(attr{r, "u"});
+  put_attribute(attr{r, attr_kind::underline});
 }
 void styledstring::color(range const& r, std::string const& _color) noexcept {
   color(r, std::string{_color});
@@ -276,8 +295,8 @@ void styledstring::replace_attr(decltype(attrs)::iterator& old_iter,
                                 attr&& new_attr) noexcept(false) {
   if (old_iter->pos == new_attr.pos) {
     // we don't need to change the order of the attrs' list
-    old_iter->name = std::move(new_attr.name);
-    old_iter->value = std::move(new_attr.value);
+    old_iter->kind = new_attr.kind;
+    old_iter->value = new_attr.value;
   } else {
     // we have to change the order of attrs' list since we are changing the
     // ranges in the attribute so it's just faster to remove existing one and
@@ -316,8 +335,8 @@ void styledstring::replace_attr(attr const& old_attr,
 void subman::swap(attr& a, attr& b) noexcept {
   using std::swap;
   swap(a.pos, b.pos);
-  swap(a.name, b.name);
   swap(a.value, b.value);
+  swap(a.kind, b.kind);
 }
 
 void subman::swap(range& a, range& b) noexcept {
@@ -332,37 +351,8 @@ range::range(size_t const& start, size_t const& finish) noexcept
 
 // attr (performance stuff)
 
-attr::attr(range const& pos, std::string&& name, std::string&& value) noexcept
-    : pos{pos}, name{std::move(name)}, value{std::move(value)} {
-}
-attr::attr(range const& pos,
-           std::string const& name,
-           std::string&& value) noexcept
-    : attr(range{pos}, std::string{name}, std::move(value)) {
-}
-attr::attr(range const& pos,
-           std::string&& name,
-           std::string const& value) noexcept
-    : attr{range{pos}, std::move(name), std::string{value}} {
-}
-attr::attr(range const& pos,
-           std::string const& name,
-           std::string const& value) noexcept
-    : attr{range{pos}, std::string{name}, std::string{value}} {
-}
-
-attr::attr(attr const& a) noexcept : attr{a.pos, a.name, a.value} {
-}
-attr::attr(attr&& a) noexcept
-    : attr{a.pos, std::move(a.name), std::move(a.value)} {
-}
-
-attr& attr::operator=(attr a) noexcept {
-  using std::swap;
-  swap(this->pos, a.pos);
-  swap(this->name, a.name);
-  swap(this->value, a.value);
-  return *this;
+attr::attr(range const& pos, attr_kind kind, std::string_view value)
+    : pos{pos}, value{value}, kind{kind} {
 }
 
 bool styledstring::operator<(styledstring const& sstr) const noexcept {
@@ -407,7 +397,7 @@ void styledstring::trim() noexcept {
   if (l) {
     auto size = content.size();
     for (auto it = std::rbegin(attrs);
-         it->pos.finish > size && it != std::rend(attrs);
+         it != std::rend(attrs) && it->pos.finish > size;
          ++it) {
       it->pos.finish -= l;
       if (it->pos.start > size)
@@ -1,9 +1,14 @@
 #ifndef STYLEDSTRING_H
 #define STYLEDSTRING_H
 
-#include <list>
+#include "small_vector.h"
+#include "value_pool.h"
+#include <cstdint>
 #include <memory>
+#include <memory_resource>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <tuple>
 
 namespace subman {
@@ -28,31 +33,42 @@ namespace subman {
   };
   void swap(subman::range& a, subman::range& b) noexcept;
 
+  /**
+   * @brief What an attribute does; each one has the name that the formats
+   * know it with (see name_of)
+   */
+  enum class attr_kind : uint8_t {
+    bold,      // "b"
+    italic,    // "i"
+    underline, // "u"
+    color,     // "color"
+    fontsize,  // "fontsize"
+    css_class, // "class": a class of webvtt
+    voice,     // "voice"
+    lang,      // "lang"
+    settings   // "settings": the cue settings of webvtt
+  };
+  constexpr size_t attr_kinds = 9;
+
+  std::string_view name_of(attr_kind kind) noexcept;
+
+  /**
+   * @brief the kind that has this name, if there's one
+   */
+  std::optional<attr_kind> attr_kind_of(std::string_view name) noexcept;
+
   struct attr {
     range
         pos; // pos is not mutable since it will be used in sorting in std::set
-    std::string name;
-    std::string value;
+    attr_value value;
+    attr_kind kind = attr_kind::bold;
 
-    // TODO: Do we really need these?
     attr() = default;
-    attr(range const& pos,
-         std::string&& name = "",
-         std::string&& value = "") noexcept;
-    attr(range const& pos,
-         std::string const& name,
-         std::string&& value = "") noexcept;
-    attr(range const& pos,
-         std::string&& name,
-         std::string const& value) noexcept;
-    attr(range const& pos,
-         std::string const& name,
-         std::string const& value) noexcept;
-
-    attr(attr const& a) noexcept;
-    attr(attr&& a) noexcept;
-
-    attr& operator=(attr a) noexcept;
+    attr(range const& pos, attr_kind kind, std::string_view value = {});
+
+    std::string_view name() const noexcept {
+      return name_of(kind);
+    }
 
     bool operator==(attr const& a) const noexcept;
     bool operator!=(attr const& a) const noexcept;
@@ -65,19 +81,36 @@ namespace subman {
   };
   void swap(subman::attr& a, subman::attr& b) noexcept;
 
+  /**
+   * @brief The attributes of a styledstring; the first two are kept inside it
+   * and the rest go to its allocator, which is the arena for the subtitles of
+   * a document
+   */
+  using attr_list = small_vector<attr, 2>;
+
+  /**
+   * @brief The text of a subtitle and its attributes
+   * They're allocated with the allocator they were given (the arena of a
+   * document, when they're in one); the copies that aren't given one go to
+   * the heap.
+   */
   class styledstring {
-    std::string content;
-    std::list<attr> attrs;
+  public:
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+
+  private:
+    std::pmr::string content;
+    attr_list attrs;
 
   public:
     styledstring() = default;
+    explicit styledstring(allocator_type const& alloc) noexcept;
     styledstring(styledstring const&) = default;
     styledstring(styledstring&& sstr) = default;
-    styledstring(decltype(content)&& content, decltype(attrs)&& attrs = {});
-    styledstring(decltype(content) const& content, decltype(attrs) attrs = {});
-    styledstring(decltype(content)&& content, decltype(attrs) const& attrs);
-    styledstring(decltype(content) const& content,
-                 decltype(attrs) const& attrs);
+    styledstring(styledstring const& sstr, allocator_type const& alloc);
+    styledstring(styledstring&& sstr, allocator_type const& alloc);
+    styledstring(decltype(content)&& content, decltype(attrs)&& attrs);
+    styledstring(std::string_view content, allocator_type const& alloc = {});
     styledstring& operator=(styledstring const&) = default;
     styledstring& operator=(styledstring&&) = default;
 
@@ -140,18 +173,21 @@ namespace subman {
     void color(range const& r, std::string const& _color) noexcept;
     void color(std::string const& _color) noexcept;
 
-    auto cget_attrs() const noexcept -> std::list<attr> const& {
+    auto cget_attrs() const noexcept -> attr_list const& {
       return attrs;
     }
-    auto get_attrs() noexcept -> std::list<attr>& {
+    auto get_attrs() noexcept -> attr_list& {
       return attrs;
     }
-    auto cget_content() const noexcept -> std::string const& {
+    auto cget_content() const noexcept -> std::pmr::string const& {
       return content;
     }
-    auto get_content() noexcept -> std::string& {
+    auto get_content() noexcept -> std::pmr::string& {
       return content;
     }
+    auto get_allocator() const noexcept -> allocator_type {
+      return content.get_allocator();
+    }
   };
 
 } // namespace subman
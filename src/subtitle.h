@@ -3,20 +3,48 @@
 
 #include "duration.h"
 #include "styledstring.h"
+#include <concepts>
+#include <memory>
+#include <type_traits>
 
 namespace subman {
 
   /**
    * @brief The subtitle struct
+   * The ones in a document are put in its arena (through the constructors
+   * that take an allocator, which its list uses).
    */
   struct subtitle {
-    mutable styledstring content;
+    using allocator_type = styledstring::allocator_type;
+
+    styledstring content;
     duration timestamps;
 
     // copy constructor
     subtitle(subtitle const& v) : content(v.content), timestamps(v.timestamps) {
     }
+    subtitle(subtitle&&) noexcept = default;
     subtitle(styledstring content, duration const& timestamps);
+    subtitle& operator=(subtitle const&) = default;
+    subtitle& operator=(subtitle&&) noexcept = default;
+
+    subtitle(std::allocator_arg_t, allocator_type const& alloc, subtitle&& v)
+        : content{std::move(v.content), alloc}, timestamps{v.timestamps} {
+    }
+    subtitle(std::allocator_arg_t,
+             allocator_type const& alloc,
+             subtitle const& v)
+        : content{v.content, alloc}, timestamps{v.timestamps} {
+    }
+    template <typename... Args>
+      requires std::constructible_from<subtitle, Args...> &&
+               (!(sizeof...(Args) == 1 &&
+                  (std::same_as<std::remove_cvref_t<Args>, subtitle> && ...)))
+    subtitle(std::allocator_arg_t, allocator_type const& alloc, Args&&... args)
+        : subtitle{std::allocator_arg,
+                   alloc,
+                   subtitle{std::forward<Args>(args)...}} {
+    }
 
     bool operator<(subtitle const&) const;
     bool operator>(subtitle const&) const;
@@ -0,0 +1,163 @@
+#include "subtitle_list.h"
+
+using subman::subtitle;
+using subman::subtitle_list;
+
+namespace {
+
+  bool same_start(subtitle const& a, subtitle const& b) noexcept {
+    return !(a < b) && !(b < a);
+  }
+
+} // namespace
+
+subtitle_list::subtitle_list() : memory{std::make_unique<arena>()} {
+  std::construct_at(&items, memory.get());
+}
+
+subtitle_list::subtitle_list(subtitle_list const& other)
+    : memory{std::make_unique<arena>()}, index{other.index} {
+  std::construct_at(&items, other.items, memory.get());
+}
+
+subtitle_list::subtitle_list(subtitle_list&& other) noexcept
+    : memory{std::move(other.memory)}, index{std::move(other.index)} {
+  std::construct_at(&items, std::move(other.items));
+  // its vector would still be using the arena that's ours now
+  std::destroy_at(&other.items);
+  std::construct_at(&other.items, std::pmr::get_default_resource());
+  other.index.stale(0);
+}
+
+subtitle_list& subtitle_list::operator=(subtitle_list const& other) {
+  if (this != &other)
+    *this = subtitle_list{other};
+  return *this;
+}
+
+subtitle_list& subtitle_list::operator=(subtitle_list&& other) noexcept {
+  if (this != &other) {
+    drop();
+    memory = std::move(other.memory);
+    index = std::move(other.index);
+    std::construct_at(&items, std::move(other.items));
+    std::destroy_at(&other.items);
+    std::construct_at(&other.items, std::pmr::get_default_resource());
+    other.index.stale(0);
+  }
+  return *this;
+}
+
+subtitle_list::~subtitle_list() noexcept {
+  drop();
+}
+
+void subtitle_list::drop() noexcept {
+  // everything in the arena goes with it
+  if (!memory)
+    std::destroy_at(&items);
+}
+
+void subtitle_list::clear() noexcept {
+  index.stale(0);
+  if (!memory) {
+    items.clear();
+    return;
+  }
+  memory->release();
+  std::construct_at(&items, memory.get());
+}
+
+void subtitle_list::merge_tail(size_t sorted) {
+  auto const mid = items.begin() + static_cast<std::ptrdiff_t>(sorted);
+  if (mid == items.end())
+    return;
+  if (!std::is_sorted(mid, items.end()))
+    std::stable_sort(mid, items.end());
+
+  // the ones that are already there win over the new ones, like in a set
+  auto first = mid;
+  if (sorted != 0 && !(*std::prev(mid) < *mid)) {
+    std::inplace_merge(items.begin(), mid, items.end());
+    first = items.begin();
+  } else if (sorted != 0) {
+    first = std::prev(mid);
+  }
+  index.stale(static_cast<size_t>(first - items.begin()));
+  items.erase(std::unique(first, items.end(), same_start), items.end());
+}
+
+std::pair<subtitle_list::iterator, bool> subtitle_list::insert(subtitle&& v) {
+  if (items.empty() || items.back() < v) {
+    index.stale(items.size());
+    items.emplace_back(std::move(v));
+    return {std::prev(items.end()), true};
+  }
+  auto it = lower_bound(v);
+  if (it != items.end() && !(v < *it))
+    return {it, false};
+  return {items.insert(it, std::move(v)), true};
+}
+
+subtitle_list::iterator subtitle_list::emplace_hint(const_iterator hint,
+                                                    subtitle&& v) {
+  if ((hint == items.cbegin() || *std::prev(hint) < v) &&
+      (hint == items.cend() || v < *hint)) {
+    index.stale(static_cast<size_t>(hint - items.cbegin()));
+    return items.insert(hint, std::move(v));
+  }
+  return insert(std::move(v)).first;
+}
+
+subtitle_list::iterator subtitle_list::replace(const_iterator it,
+                                               subtitle&& v) {
+  auto const position = it - items.cbegin();
+  auto const place = items.begin() + position;
+  index.stale(static_cast<size_t>(position));
+  if ((place == items.begin() || *std::prev(place) < v) &&
+      (std::next(place) == items.end() || v < *std::next(place))) {
+    *place = std::move(v);
+    return place;
+  }
+  items.erase(place);
+  return insert(std::move(v)).first;
+}
+
+void subtitle_list::replace(const_iterator first,
+                            const_iterator last,
+                            std::pmr::vector<subtitle>&& parts) {
+  auto const position = first - items.cbegin();
+  auto const size = last - first;
+  index.stale(static_cast<size_t>(position));
+
+  // they go in one move if they're in order and between the neighbours
+  auto const fits =
+      (first == items.cbegin() || parts.empty() ||
+       *std::prev(first) < parts.front()) &&
+      (last == items.cend() || parts.empty() || parts.back() < *last) &&
+      std::adjacent_find(parts.begin(),
+                         parts.end(),
+                         [](subtitle const& a, subtitle const& b) {
+                           return !(a < b);
+                         }) == parts.end();
+  if (!fits) {
+    items.erase(first, last);
+    insert(std::make_move_iterator(parts.begin()),
+           std::make_move_iterator(parts.end()));
+    return;
+  }
+
+  auto const common = std::min(size, static_cast<std::ptrdiff_t>(parts.size()));
+  auto const place = items.begin() + position;
+  std::move(parts.begin(), parts.begin() + common, place);
+  if (common < size)
+    items.erase(place + common, place + size);
+  else
+    items.insert(place + common,
+                 std::make_move_iterator(parts.begin() + common),
+                 std::make_move_iterator(parts.end()));
+}
+
+void subtitle_list::restore_order() {
+  merge_tail(0);
+}
@@ -0,0 +1,212 @@
+#ifndef SUBTITLE_LIST_H
+#define SUBTITLE_LIST_H
+
+#include "arena.h"
+#include "interval_index.h"
+#include "subtitle.h"
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+namespace subman {
+
+  /**
+   * @brief The subtitles of a document, sorted by their start, in one
+   * contiguous vector
+   * It keeps the ordering of the std::set<subtitle> it replaces: one
+   * subtitle for each start, and inserting one with a start that's already
+   * there doesn't do anything. A range of subtitles is put at the end and
+   * merged in, in one pass.
+   * The subtitles can be changed through the iterators, but their starts
+   * should only be changed through "replace", or followed by
+   * "restore_order".
+   * Getting to the subtitles in a way that they can be changed marks them as
+   * changed for the index of "overlapping", so read them through the const
+   * ones when they're not changed.
+   *
+   * The subtitles, their text and their attributes are all in the list's
+   * arena; the ones that are put in are copied into it (or just moved, when
+   * they were made with "get_allocator"). So destroying or clearing the list
+   * just lets go of the arena, without going through the subtitles; a
+   * subtitle that's moved out of the list shouldn't outlive it.
+   * A list that was moved from has no arena, and uses the heap.
+   */
+  class subtitle_list {
+    using storage = std::pmr::vector<subtitle>;
+
+    std::unique_ptr<arena> memory;
+    union {
+      storage items; // never destroyed when it's in the arena
+    };
+    interval_index index;
+
+    // merges the unsorted subtitles that are put after "sorted"
+    void merge_tail(size_t sorted);
+
+    // lets go of the subtitles; they're destroyed only if they're not in the
+    // arena
+    void drop() noexcept;
+
+  public:
+    using value_type = subtitle;
+    using allocator_type = storage::allocator_type;
+    using iterator = storage::iterator;
+    using const_iterator = storage::const_iterator;
+    using reverse_iterator = storage::reverse_iterator;
+    using const_reverse_iterator = storage::const_reverse_iterator;
+
+    subtitle_list();
+    subtitle_list(subtitle_list const& other);
+    subtitle_list(subtitle_list&& other) noexcept;
+    subtitle_list& operator=(subtitle_list const& other);
+    subtitle_list& operator=(subtitle_list&& other) noexcept;
+    ~subtitle_list() noexcept;
+
+    template <typename It>
+    subtitle_list(It first, It last) : subtitle_list{} {
+      insert(first, last);
+    }
+
+    /**
+     * @brief the allocator of the arena; the subtitles that are made with it
+     * are moved into the list without being copied
+     */
+    allocator_type get_allocator() const noexcept {
+      return items.get_allocator();
+    }
+
+    auto begin() noexcept {
+      index.stale(0);
+      return items.begin();
+    }
+    auto end() noexcept {
+      index.stale(0);
+      return items.end();
+    }
+    auto begin() const noexcept {
+      return items.begin();
+    }
+    auto end() const noexcept {
+      return items.end();
+    }
+    auto cbegin() const noexcept {
+      return items.cbegin();
+    }
+    auto cend() const noexcept {
+      return items.cend();
+    }
+    auto rbegin() noexcept {
+      index.stale(0);
+      return items.rbegin();
+    }
+    auto rend() noexcept {
+      index.stale(0);
+      return items.rend();
+    }
+    auto rbegin() const noexcept {
+      return items.rbegin();
+    }
+    auto rend() const noexcept {
+      return items.rend();
+    }
+
+    auto size() const noexcept {
+      return items.size();
+    }
+    bool empty() const noexcept {
+      return items.empty();
+    }
+    /**
+     * @brief removes all the subtitles, and lets go of the arena at once
+     */
+    void clear() noexcept;
+    void reserve(size_t count) {
+      items.reserve(count);
+    }
+
+    subtitle& operator[](size_t position) noexcept {
+      index.stale(position);
+      return items[position];
+    }
+    subtitle const& operator[](size_t position) const noexcept {
+      return items[position];
+    }
+
+    iterator lower_bound(subtitle const& v) noexcept {
+      auto const it = std::lower_bound(items.begin(), items.end(), v);
+      index.stale(static_cast<size_t>(it - items.begin()));
+      return it;
+    }
+    const_iterator lower_bound(subtitle const& v) const noexcept {
+      return std::lower_bound(items.begin(), items.end(), v);
+    }
+
+    std::pair<iterator, bool> insert(subtitle&& v);
+    std::pair<iterator, bool> insert(subtitle const& v) {
+      return insert(subtitle{std::allocator_arg, get_allocator(), v});
+    }
+
+    /**
+     * @brief inserts a range of subtitles (in any order) with one merge
+     */
+    template <typename It>
+    void insert(It first, It last) {
+      auto const sorted = items.size();
+      items.insert(items.end(), first, last);
+      merge_tail(sorted);
+    }
+
+    /**
+     * @brief inserts the subtitle right before "hint" if that's its place
+     * @return the inserted one, or the one that has the same start
+     */
+    iterator emplace_hint(const_iterator hint, subtitle&& v);
+    template <typename... Args>
+    iterator emplace_hint(const_iterator hint, Args&&... args) {
+      return emplace_hint(hint, subtitle{std::forward<Args>(args)...});
+    }
+
+    iterator erase(const_iterator it) {
+      index.stale(static_cast<size_t>(it - items.cbegin()));
+      return items.erase(it);
+    }
+    iterator erase(const_iterator first, const_iterator last) {
+      index.stale(static_cast<size_t>(first - items.cbegin()));
+      return items.erase(first, last);
+    }
+
+    /**
+     * @brief replaces the subtitle; it's moved to its new place if its start
+     * has changed
+     */
+    iterator replace(const_iterator it, subtitle&& v);
+
+    /**
+     * @brief replaces the subtitles in [first, last) with the parts, which
+     * are in order; if they don't fit there, they're inserted one by one
+     */
+    void replace(const_iterator first,
+                 const_iterator last,
+                 std::pmr::vector<subtitle>&& parts);
+
+    /**
+     * @brief the positions of the subtitles that collide with the duration,
+     * in order
+     */
+    std::vector<size_t> overlapping(duration const& d) {
+      return index.overlapping(items, d);
+    }
+
+    /**
+     * @brief sorts the subtitles again after their starts were changed
+     * through the iterators
+     */
+    void restore_order();
+  };
+
+} // namespace subman
+
+#endif // SUBTITLE_LIST_H
@@ -1,49 +1,486 @@
 #include "utilities.h"
-#include "formats/subrip.h"
+#include "cache.h"
+#include "encoding.h"
+#include "formats/export.h"
+#include "formats/registry.h"
+#include "gzip.h"
+#include "mapped_file.h"
+#include <array>
 #include <boost/filesystem.hpp>
 #include <fstream>
+#include <iostream>
+#include <optional>
+#include <type_traits>
+
+using subman::formats::known_formats;
+
+namespace {
+
+  // the formats are recognized by their first lines
+  constexpr size_t sniff_size = 4096;
+
+  /**
+   * @brief reads the normalized text with the format that recognizes it, or
+   * with the one that the extension says
+   */
+  subman::document read_text(std::string_view text,
+                             std::string const& ext,
+                             bool* frame_based = nullptr) {
+    subman::document doc;
+    auto const reader = [&]<typename Format>() {
+      doc = subman::load<Format>(text);
+      if (frame_based)
+        *frame_based = std::is_same_v<Format, subman::formats::microdvd>;
+    };
+    if (known_formats::with_sniffed(text.substr(0, sniff_size), reader) ||
+        known_formats::with_name(ext, reader))
+      return doc;
+    throw std::invalid_argument("Error: Unknown subtitle format (" + ext +
+                                ").");
+  }
+
+  /**
+   * @brief the extension that tells the format ("a.srt.gz" is ".srt")
+   */
+  std::string format_extension(std::string const& path) {
+    boost::filesystem::path const file{path};
+    if (".gz" == file.extension())
+      return file.stem().extension().string();
+    return file.extension().string();
+  }
+
+  void warn_invalid(subman::utf8_text const& text, std::string const& path) {
+    if (auto const invalid = text.invalid_sequences()) {
+      std::cerr << "Warning: " << invalid << " invalid character(s) in '"
+                << path << "' were replaced with U+FFFD." << std::endl;
+    }
+  }
+
+  /**
+   * @brief parses the file itself (not its cache)
+   */
+  subman::document read_file(std::string const& path,
+                             bool* frame_based = nullptr) {
+    subman::mapped_file file{path};
+    auto raw = file.view();
+    std::string inflated;
+    if (subman::is_gzip(raw)) {
+      inflated = subman::gunzip(raw);
+      raw = inflated;
+    }
+    subman::utf8_text text{raw};
+    warn_invalid(text, path);
+    return read_text(text.view(), format_extension(path), frame_based);
+  }
+
+  /**
+   * @brief takes up to "size" bytes out of the stream buffer
+   */
+  std::string take(std::streambuf& source, size_t size) {
+    std::string taken(size, '\0');
+    taken.resize(static_cast<size_t>(
+        source.sgetn(taken.data(), static_cast<std::streamsize>(size))));
+    return taken;
+  }
+
+  /**
+   * @brief A stream buffer that gives the bytes that were taken out of
+   * "source" back first, and then goes on with the rest of it; a pipe can't
+   * seek back to its beginning once its head has been looked at
+   */
+  class replay_istreambuf : public std::streambuf {
+    std::string head;
+    std::streambuf& source;
+    std::array<char, 64 * 1024> block;
+    bool replayed = false;
+
+  protected:
+    int_type underflow() override {
+      if (gptr() < egptr())
+        return traits_type::to_int_type(*gptr());
+      if (!replayed && !head.empty()) {
+        replayed = true;
+        setg(head.data(), head.data(), head.data() + head.size());
+        return traits_type::to_int_type(head[0]);
+      }
+      replayed = true;
+      auto const count = source.sgetn(
+          block.data(), static_cast<std::streamsize>(block.size()));
+      if (count <= 0)
+        return traits_type::eof();
+      setg(block.data(), block.data(), block.data() + count);
+      return traits_type::to_int_type(block[0]);
+    }
+
+  public:
+    replay_istreambuf(std::string head, std::streambuf& source) noexcept
+        : head{std::move(head)},
+          source{source} {
+    }
+    replay_istreambuf(replay_istreambuf const&) = delete;
+    replay_istreambuf& operator=(replay_istreambuf const&) = delete;
+  };
+
+  /**
+   * @brief The standard input, inflated as it's read when it's gzip'd, so
+   * that only a block of it is in the memory at once
+   */
+  class piped_input {
+    std::string magic = take(*std::cin.rdbuf(), 2);
+    replay_istreambuf raw{magic, *std::cin.rdbuf()};
+    std::istream raw_in{&raw};
+    std::optional<subman::gzip_istreambuf> inflater;
+
+  public:
+    piped_input() noexcept(false) {
+      if (subman::is_gzip(magic))
+        inflater.emplace(raw_in);
+    }
+    piped_input(piped_input const&) = delete;
+    piped_input& operator=(piped_input const&) = delete;
+
+    std::streambuf* rdbuf() noexcept {
+      return inflater ? static_cast<std::streambuf*>(&*inflater) : &raw;
+    }
+  };
+
+  // the cues have gone back in time; the document has to sort them out
+  struct out_of_order {};
+
+  /**
+   * @brief passes the cues on, as long as each one can simply go after the
+   * one before it
+   */
+  subman::generator<subman::subtitle>
+  ordered(subman::generator<subman::subtitle>& cues) {
+    std::optional<subman::duration> last;
+    for (auto& cue : cues) {
+      if (last && !subman::document_builder::in_order(*last, cue.timestamps))
+        throw out_of_order{};
+      last = cue.timestamps;
+      co_yield std::move(cue);
+    }
+  }
+
+  /**
+   * @brief reads the cues of the file once, to see if they can be streamed
+   */
+  bool is_ordered(std::string const& input) {
+    auto source = subman::cues(input);
+    try {
+      for (auto const& cue : ordered(source))
+        static_cast<void>(cue);
+    } catch (out_of_order const&) {
+      return false;
+    }
+    return true;
+  }
+
+  bool is_stdout(std::string const& path) noexcept {
+    return path.empty() || "--" == path || "-" == path;
+  }
+
+  /**
+   * @brief streams the cues of the input into the output
+   * @return false if the cues are out of order and nothing is written yet
+   */
+  template <typename Format>
+  bool stream_into(std::string const& input,
+                   std::string const& output,
+                   size_t window) {
+    // what's gone to the standard output can't be taken back, so the order
+    // is checked first (the input is a file, so it can be read again)
+    if (is_stdout(output) && !is_ordered(input))
+      return false;
+    auto source = subman::cues(input);
+    auto cues = ordered(source);
+    if (is_stdout(output)) {
+      subman::stdout_sink sink{window};
+      std::ostream out{&sink};
+      out.exceptions(std::ios::badbit);
+      try {
+        Format::write(cues, out);
+      } catch (out_of_order const&) {
+        if (sink.has_written()) {
+          throw std::invalid_argument(
+              "Error: The cues of '" + input +
+              "' are out of order; convert it into a file instead.");
+        }
+        sink.discard();
+        return false;
+      }
+      sink.close();
+      return true;
+    }
+
+    std::ofstream file(output, std::ios::out | std::ios::binary);
+    if (!file.good())
+      throw std::invalid_argument("Error: Cannot open file '" + output + "'");
+    std::optional<subman::gzip_ostreambuf> deflater;
+    std::ostream out{file.rdbuf()};
+    if (".gz" == boost::filesystem::extension(output)) {
+      deflater.emplace(file);
+      out.rdbuf(&*deflater);
+    }
+    out.exceptions(std::ios::badbit);
+    try {
+      Format::write(cues, out);
+    } catch (out_of_order const&) {
+      // the document rewrites the file
+      return false;
+    }
+    if (deflater)
+      deflater->close();
+    return true;
+  }
+
+  /**
+   * @brief opens the output ("" or "--" is the standard output, and ".gz"
+   * files are compressed) and hands its stream to the writer
+   */
+  template <typename Writer>
+  void with_output(std::string const& output, size_t window, Writer&& writer) {
+    if (is_stdout(output)) {
+      subman::stdout_sink sink{window};
+      std::ostream out{&sink};
+      out.exceptions(std::ios::badbit);
+      writer(out);
+      sink.close();
+      return;
+    }
+    std::ofstream file(output, std::ios::out | std::ios::binary);
+    if (!file.good())
+      throw std::invalid_argument("Error: Cannot open file '" + output + "'");
+    std::optional<subman::gzip_ostreambuf> deflater;
+    std::ostream out{file.rdbuf()};
+    if (".gz" == boost::filesystem::extension(output)) {
+      deflater.emplace(file);
+      out.rdbuf(&*deflater);
+    }
+    out.exceptions(std::ios::badbit);
+    writer(out);
+    if (deflater)
+      deflater->close();
+  }
+
+  template <typename Format>
+  subman::generator<subman::subtitle> cues_of(std::istream& in) {
+    if constexpr (requires { Format::cues(in); }) {
+      for (auto& cue : Format::cues(in))
+        co_yield std::move(cue);
+    } else {
+      // this format can't be streamed
+      auto doc = Format::read(in);
+      for (auto const& cue : doc.subtitles)
+        co_yield subman::subtitle{cue};
+    }
+  }
+
+} // namespace
 
-// read from file
-template <typename SubtitleType>
-subman::document subman::load(std::istream& in) {
-  return SubtitleType::read(in);
-}
 subman::document subman::load(std::string const& path) {
+  if ("-" == path) {
+    piped_input piped;
+    std::istream in{piped.rdbuf()};
+    in.exceptions(std::ios::badbit);
+    std::string const data{std::istreambuf_iterator<char>{in}, {}};
+    subman::utf8_text text{data};
+    warn_invalid(text, path);
+    return read_text(text.view(), "");
+  }
   if (!boost::filesystem::exists(path)) {
     throw std::invalid_argument("Error: File '" + path + "' does not exits.");
   }
-  std::ifstream in(path, std::ios::in);
-  if (in.good()) {
-    auto ext = boost::filesystem::extension(path);
-    if (".srt" == ext) {
-      return load<subman::formats::subrip>(in);
+  if (auto cached = subman::load_cache(path))
+    return std::move(*cached);
+  return read_file(path);
+}
+
+bool subman::refresh_cache(std::string const& path) {
+  // the stamp is taken first, so that a change while reading is noticed
+  auto stamp = subman::stamp_of(path, true);
+  if (!stamp)
+    throw std::invalid_argument("Error: Cannot read '" + path + "'.");
+  bool frame_based = false;
+  auto const doc = read_file(path, &frame_based);
+  if (!frame_based)
+    stamp->fps_num = stamp->fps_den = 0;
+  return subman::write_cache(doc, path, *stamp);
+}
+
+subman::generator<subman::subtitle> subman::cues(std::string path) {
+  std::string ext;
+  std::ifstream file;
+  std::optional<piped_input> piped;
+  std::optional<replay_istreambuf> sniffed;
+  std::optional<subman::gzip_istreambuf> inflater;
+  std::istream in{nullptr};
+
+  // starts reading (again) from the beginning
+  auto const rewind = [&] {
+    in.clear();
+    if (inflater) {
+      file.clear();
+      file.seekg(0);
+      inflater.emplace(file);
+      in.rdbuf(&*inflater);
+    } else {
+      in.seekg(0);
+    }
+  };
+
+  if ("-" == path) {
+    piped.emplace();
+    in.rdbuf(piped->rdbuf());
+  } else {
+    if (!boost::filesystem::exists(path)) {
+      throw std::invalid_argument("Error: File '" + path +
+                                  "' does not exits.");
+    }
+    ext = format_extension(path);
+    file.open(path, std::ios::in | std::ios::binary);
+    if (!file.good()) {
+      throw std::invalid_argument("Error: Cannot open '" + path + "'.");
     }
+    char magic[2];
+    file.read(magic, sizeof(magic));
+    if (subman::is_gzip({magic, static_cast<size_t>(file.gcount())}))
+      inflater.emplace(file);
+    in.rdbuf(file.rdbuf());
+  }
+  // the errors of the decompression come out of the stream buffer
+  in.exceptions(std::ios::badbit);
+  if (!piped)
+    rewind();
+
+  std::string head(sniff_size, '\0');
+  in.read(head.data(), static_cast<std::streamsize>(head.size()));
+  head.resize(static_cast<size_t>(in.gcount()));
+  if (piped) {
+    // the pipe can't go back, so the head is given back before the rest
+    sniffed.emplace(head, *piped->rdbuf());
+    in.rdbuf(&*sniffed);
+  } else {
+    rewind();
+  }
+
+  // the streaming readers take UTF-8 only
+  size_t bom_size;
+  if (subman::detect_encoding(head, bom_size) != subman::text_encoding::UTF8) {
+    std::string data{std::istreambuf_iterator<char>{in}, {}};
+    subman::utf8_text text{data};
+    auto doc = read_text(text.view(), ext);
+    for (auto const& cue : doc.subtitles)
+      co_yield subman::subtitle{cue};
+    co_return;
+  }
+  in.ignore(static_cast<std::streamsize>(bom_size));
+
+  subman::utf8_text text{head};
+  subman::generator<subman::subtitle> source;
+  auto const streamer = [&]<typename Format>() {
+    source = cues_of<Format>(in);
+  };
+  if (!known_formats::with_sniffed(text.view(), streamer) &&
+      !known_formats::with_name(ext, streamer)) {
     throw std::invalid_argument("Error: Unknown subtitle format (" + ext +
                                 ").");
   }
-  throw std::invalid_argument("Error: Cannot open '" + path + "'.");
+  for (auto& cue : source)
+    co_yield std::move(cue);
 }
 
-// write to file
-template <typename SubtitleType>
-void subman::write(const subman::document& doc, std::ostream& out) {
-  SubtitleType::write(doc, out);
+void subman::write(const subman::document& doc,
+                   std::ostream& out,
+                   std::string const& format) {
+  auto const writer = [&]<typename Format>() {
+    subman::write<Format>(doc, out);
+  };
+  if (!known_formats::with_name(format, writer)) {
+    throw std::invalid_argument("Error: Unknown subtitle format (" + format +
+                                ").");
+  }
 }
+
 void subman::write(const subman::document& doc,
                    std::string const& path,
                    std::string format) {
-  std::ofstream out(path, std::ios::out);
-  if (out.good()) {
-    auto ext = boost::filesystem::extension(path);
-    if (format.empty() || "auto" == format) {
-      format = ext;
-    }
-    if (".srt" == format) {
-      subman::formats::subrip::write(doc, out);
-      return;
+  if (format.empty() || "auto" == format) {
+    format = format_extension(path);
+  }
+  if (".gz" == boost::filesystem::extension(path)) {
+    std::ofstream out(path, std::ios::out | std::ios::binary);
+    if (!out.good())
+      throw std::invalid_argument("Error: Cannot open file '" + path + "'");
+    subman::gzip_ostreambuf deflater{out};
+    std::ostream compressed{&deflater};
+    compressed.exceptions(std::ios::badbit);
+    write(doc, compressed, format);
+    deflater.close();
+    return;
+  }
+  auto const writer = [&]<typename Format>() {
+    subman::write<Format>(doc, path);
+  };
+  if (!known_formats::with_name(format, writer)) {
+    throw std::invalid_argument("Error: Unknown subtitle format (" + format +
+                                ").");
+  }
+}
+
+void subman::convert(std::string const& input,
+                     std::string const& output,
+                     std::string format,
+                     size_t window) {
+  auto const to_stdout = is_stdout(output);
+  if (format.empty() || "auto" == format)
+    format = to_stdout ? "srt" : format_extension(output);
+
+  // the standard input is read as a whole anyway, and can't be read again
+  bool streamed = false;
+  auto const streamer = [&]<typename Format>() {
+    if constexpr (requires(subman::generator<subman::subtitle>& cues,
+                           std::ostream& out) { Format::write(cues, out); }) {
+      if ("-" != input)
+        streamed = stream_into<Format>(input, output, window);
     }
-    throw std::invalid_argument("Error: Unknown subtitle format (" + ext +
+  };
+  if (!known_formats::with_name(format, streamer)) {
+    throw std::invalid_argument("Error: Unknown subtitle format (" + format +
+                                ").");
+  }
+  if (streamed)
+    return;
+
+  auto const doc = load(input);
+  if (!to_stdout)
+    return write(doc, output, format);
+  with_output(output, window, [&](std::ostream& out) {
+    write(doc, out, format);
+  });
+}
+
+void subman::export_to(std::string const& input,
+                       std::string const& output,
+                       std::string format,
+                       size_t window) {
+  if (format.empty() || "auto" == format) {
+    auto const ext = is_stdout(output) ? "" : format_extension(output);
+    format = ".subcol" == ext ? "columnar" : "ndjson";
+    if (!ext.empty() && ".subcol" != ext && ".ndjson" != ext &&
+        ".jsonl" != ext) {
+      throw std::invalid_argument("Error: Unknown export format (" + ext +
+                                  ").");
+    }
+  }
+  if ("ndjson" != format && "columnar" != format) {
+    throw std::invalid_argument("Error: Unknown export format (" + format +
                                 ").");
   }
-  throw std::invalid_argument("Error: Cannot open file '" + path + "'");
+  with_output(output, window, [&](std::ostream& out) {
+    if ("ndjson" == format)
+      subman::formats::write_ndjson(subman::cues(input), input, out);
+    else
+      subman::formats::write_columnar(subman::cues(input), out);
+  });
 }
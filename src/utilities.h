@@ -2,26 +2,99 @@
 #define UTILITIES_H
 
 #include "document.h"
+#include "generator.h"
+#include "stdout_sink.h"
 #include <algorithm>
 #include <cctype>
+#include <fstream>
+#include <istream>
 #include <locale>
 #include <ostream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 
 namespace subman {
 
-  // read from file
+  // read with a specific format
   template <typename SubtitleType>
-  subman::document load(std::istream& in);
+  subman::document load(std::istream& in) {
+    return SubtitleType::read(in);
+  }
+  template <typename SubtitleType>
+  subman::document load(std::string_view text) {
+    return SubtitleType::read(text);
+  }
+
+  /**
+   * @brief read from file ("-" is the standard input); the format is
+   * detected from the content and then from the extension
+   * A fresh cache next to the file (see cache.h) is loaded instead.
+   */
   subman::document load(std::string const& path);
 
-  // write to file
+  /**
+   * @brief parses the file (not its cache) and writes its cache next to it
+   * @return false if the file was changed while it was being parsed; the
+   * cache is not written then
+   */
+  bool refresh_cache(std::string const& path);
+
+  // read the file one cue at a time
+  subman::generator<subman::subtitle> cues(std::string path);
+
+  // write with a specific format
+  template <typename SubtitleType>
+  void write(const subman::document& doc, std::ostream& out) {
+    SubtitleType::write(doc, out);
+  }
   template <typename SubtitleType>
-  void write(const subman::document& doc, std::ostream& out);
+  void write(const subman::document& doc, std::string const& path) {
+    if constexpr (requires { SubtitleType::write(doc, path); }) {
+      // the format knows a better way of writing into files
+      SubtitleType::write(doc, path);
+    } else {
+      std::ofstream out(path, std::ios::out | std::ios::binary);
+      if (!out.good())
+        throw std::invalid_argument("Error: Cannot open file '" + path + "'");
+      SubtitleType::write(doc, out);
+    }
+  }
+
+  /**
+   * @brief write with the format that has this name or extension
+   */
+  void write(const subman::document& doc,
+             std::ostream& out,
+             std::string const& format);
+
+  // write to file
   void write(const subman::document& doc,
              std::string const& path,
              std::string format = "auto");
 
+  /**
+   * @brief converts the file into another format ("" or "--" is the standard
+   * output) without loading all of it; the cues are written as they are read
+   * The document is loaded only when the cues are out of order or when the
+   * output format can't be streamed. The standard output holds "window" bytes
+   * before writing, so the small inputs can still go back to the document.
+   */
+  void convert(std::string const& input,
+               std::string const& output,
+               std::string format = "auto",
+               size_t window = default_flush_size);
+
+  /**
+   * @brief exports the cues of the file for the analytics tools, as they are
+   * read; the format is "ndjson" (".ndjson", ".jsonl") or "columnar"
+   * (".subcol"), and the standard output gets NDJSON by default
+   */
+  void export_to(std::string const& input,
+                 std::string const& output,
+                 std::string format = "auto",
+                 size_t window = default_flush_size);
+
 }; // namespace subman
 
 #endif // UTILITIES_H
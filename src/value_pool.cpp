@@ -0,0 +1,77 @@
+#include "value_pool.h"
+#include <array>
+#include <bit>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+using subman::attr_value;
+
+namespace {
+
+  /**
+   * @brief the values that the attributes have had, each one once
+   * The views are kept in pages that double in size and never move, so an
+   * id can be looked up while new ones are being added to the later pages.
+   */
+  class value_pool {
+    static constexpr size_t first_page = 64;
+    static constexpr size_t pages_count = 26; // almost 2^32 of them
+
+    std::mutex lock;
+    std::pmr::monotonic_buffer_resource text;
+    std::unordered_map<std::string_view, uint32_t> ids;
+    std::array<std::unique_ptr<std::string_view[]>, pages_count> pages;
+    uint32_t count = 1; // 0 is the empty value, which is never looked up
+
+    static std::pair<size_t, size_t> place_of(size_t id) noexcept {
+      auto const page =
+          static_cast<size_t>(std::bit_width(id / first_page + 1)) - 1;
+      return {page, id - first_page * ((size_t{1} << page) - 1)};
+    }
+
+  public:
+    uint32_t intern(std::string_view value) {
+      std::lock_guard<std::mutex> guard{lock};
+      if (auto const it = ids.find(value); it != ids.end())
+        return it->second;
+
+      auto const [page, offset] = place_of(count);
+      if (page == pages_count)
+        throw std::invalid_argument("Error: Too many attribute values.");
+      if (!pages[page])
+        pages[page] = std::make_unique<std::string_view[]>(first_page << page);
+      auto* const chars = static_cast<char*>(text.allocate(value.size(), 1));
+      std::memcpy(chars, value.data(), value.size());
+      std::string_view const kept{chars, value.size()};
+      pages[page][offset] = kept;
+      ids.emplace(kept, count);
+      return count++;
+    }
+
+    std::string_view operator[](uint32_t id) const noexcept {
+      auto const [page, offset] = place_of(id);
+      return pages[page][offset];
+    }
+  };
+
+  value_pool& pool() {
+    static value_pool values;
+    return values;
+  }
+
+} // namespace
+
+attr_value::attr_value(std::string_view value)
+    : id{value.empty() ? 0 : pool().intern(value)} {
+}
+
+std::string_view attr_value::view() const noexcept {
+  if (id == 0)
+    return {};
+  return pool()[id];
+}
@@ -0,0 +1,41 @@
+#ifndef VALUE_POOL_H
+#define VALUE_POOL_H
+
+#include <cstdint>
+#include <string_view>
+
+namespace subman {
+
+  /**
+   * @brief The value of an attribute (a color, a font size, a class, ...),
+   * as its id in the pool of values
+   * The values are interned once for the whole process, so the same color
+   * on a hundred thousand cues is one string, and comparing two values is
+   * comparing two integers. The text is looked up when it's needed (mostly
+   * when it's written); it stays where it is until the process ends, so its
+   * views never go stale.
+   * Interning a value takes a lock, looking one up doesn't; the ids that a
+   * thread has been handed can be looked up while others intern new ones.
+   */
+  class attr_value {
+    uint32_t id = 0; // the empty value
+
+  public:
+    attr_value() noexcept = default;
+    explicit attr_value(std::string_view value);
+
+    std::string_view view() const noexcept;
+    operator std::string_view() const noexcept {
+      return view();
+    }
+
+    bool empty() const noexcept {
+      return id == 0;
+    }
+
+    bool operator==(attr_value const&) const noexcept = default;
+  };
+
+} // namespace subman
+
+#endif // VALUE_POOL_H